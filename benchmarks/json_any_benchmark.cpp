@@ -17,6 +17,7 @@
 #include "benchmark.h"
 
 #include "native/json/any.h"
+#include "native/json/patch.h"
 
 #include <boost/timer/timer.hpp>
 
@@ -84,6 +85,117 @@ BENCHMARK(json_any_benchmark, parse_ifstream)
     benchmark("parse_stream", func);
 }
 
+BENCHMARK(json_any_benchmark, parse_string_hinted)
+{
+    native::json::any first;
+    native::json::any::handler recorder{first};
+    native::json::parser{}.parse(_text, recorder);
+
+    auto func = [&]()
+    {
+        native::json::any value;
+        native::json::any::handler handler{value, recorder.sizes()};
+        native::json::parser{}.parse(_text, handler);
+    };
+    benchmark("parse_string", func);
+}
+
+BENCHMARK(json_any_benchmark, parse_string_lazy_numbers)
+{
+    auto func = [&]()
+    {
+        native::json::any value;
+        native::json::any::handler handler{value, native::json::number_lazy};
+        native::json::parser{}.parse(_text, handler);
+    };
+    benchmark("parse_string", func);
+}
+
+BENCHMARK(json_any_benchmark, parse_string_ordered)
+{
+    auto func = [&]()
+    {
+        native::json::parse<native::json::ordered_any>(_text);
+    };
+    benchmark("parse_string", func);
+}
+
+BENCHMARK(json_any_benchmark, dump)
+{
+    const auto value = native::json::parse(_text);
+    auto func = [&]()
+    {
+        value.dump();
+    };
+    benchmark("dump", func);
+}
+
+BENCHMARK(json_any_benchmark, dump_ordered)
+{
+    const auto value = native::json::parse<native::json::ordered_any>(_text);
+    auto func = [&]()
+    {
+        value.dump();
+    };
+    benchmark("dump", func);
+}
+
+BENCHMARK(json_any_benchmark, copy)
+{
+    const auto value = native::json::parse(_text);
+    auto func = [&]()
+    {
+        native::json::any copy{value};
+    };
+    benchmark("copy", func);
+}
+
+BENCHMARK(json_any_benchmark, share)
+{
+    const auto value = native::json::parse(_text);
+    auto func = [&]()
+    {
+        auto copy = value.share();
+    };
+    benchmark("copy", func);
+}
+
+BENCHMARK(json_any_benchmark, equal)
+{
+    const auto value = native::json::parse(_text);
+    const auto other = native::json::parse(_text);
+    auto func = [&]()
+    {
+        EXPECT_EQ(value, other);
+    };
+    benchmark("equal", func);
+}
+
+BENCHMARK(json_any_benchmark, hash_after_change)
+{
+    auto value = native::json::parse(_text);
+    value.hash();
+    auto func = [&]()
+    {
+        // only the root's hash is worked out again
+        value["changed"] = 1;
+        value.hash();
+    };
+    benchmark("hash", func);
+}
+
+BENCHMARK(json_any_benchmark, diff)
+{
+    const auto from = native::json::parse(_text);
+    auto to = from.share();
+    to["changed"] = 1;
+    auto func = [&]()
+    {
+        native::json::diff(from, to);
+    };
+    benchmark("diff", func);
+}
+
 #if defined(JSON11)
 BENCHMARK(json_any_benchmark, json11_parse_string)
 {
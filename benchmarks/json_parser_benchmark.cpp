@@ -16,7 +16,9 @@
 
 #include "benchmark.h"
 
+#include "native/json/minify.h"
 #include "native/json/parser.h"
+#include "native/json/validate.h"
 
 #include <boost/timer/timer.hpp>
 
@@ -98,6 +100,26 @@ BENCHMARK(json_parser_benchmark, parse_stream_empty_handler)
     benchmark("parse_stream_empty_handler", func);
 }
 
+BENCHMARK(json_parser_benchmark, validate_string)
+{
+    auto func = [&]()
+    {
+        native::json::validate(_text);
+    };
+    benchmark("validate_string", func);
+}
+
+BENCHMARK(json_parser_benchmark, minify_string)
+{
+    std::string text;
+    auto func = [&]()
+    {
+        text = _text;
+        native::json::minify(text);
+    };
+    benchmark("minify_string", func);
+}
+
 #if defined(RAPID_JSON)
 BENCHMARK(json_parser_benchmark, rapidjson_parse_string_empty_handler)
 {
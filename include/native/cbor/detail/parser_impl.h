@@ -0,0 +1,545 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_CBOR_PARSER_IMPL_H__
+#define NATIVE_CBOR_PARSER_IMPL_H__
+
+#include "native/config.h"
+
+#include "native/cbor/exceptions.h"
+#include "native/detail/big_endian.h"
+#include "native/detail/typed_value.h"
+#include "native/json/types.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace native
+{
+namespace cbor
+{
+namespace detail
+{
+
+// major types, the top three bits of the initial byte
+enum major_type : std::uint8_t
+{
+    major_unsigned = 0,
+    major_negative = 1,
+    major_bytes = 2,
+    major_text = 3,
+    major_array = 4,
+    major_map = 5,
+    major_tag = 6,
+    major_simple = 7,
+};
+
+// additional information, the low five bits
+enum : std::uint8_t
+{
+    info_uint8 = 24,
+    info_uint16 = 25,
+    info_uint32 = 26,
+    info_uint64 = 27,
+    info_indefinite = 31,
+};
+
+// tags that are turned into numbers
+enum : std::uint64_t
+{
+    tag_epoch_time = 1,
+    tag_positive_bignum = 2,
+    tag_negative_bignum = 3,
+    tag_decimal_fraction = 4,
+    tag_bigfloat = 5,
+};
+
+const std::uint8_t break_code = 0xff;
+
+// RFC 8949 appendix D
+inline double half_to_double(std::uint16_t half)
+{
+    const int exponent = (half >> 10) & 0x1f;
+    const int mantissa = half & 0x3ff;
+    double value;
+    if (exponent == 0)
+    {
+        value = std::ldexp(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = std::ldexp(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        value = mantissa == 0 ? std::numeric_limits<double>::infinity()
+                              : std::numeric_limits<double>::quiet_NaN();
+    }
+    return half & 0x8000 ? -value : value;
+}
+
+// what typed_integer() and typed_real() throw for this parser
+struct number_errors
+{
+    using number_too_big_for_expected_type =
+        cbor::number_too_big_for_expected_type;
+    using unexpected_signed_value = cbor::unexpected_signed_value;
+    using unexpected_decimal_value = cbor::unexpected_decimal_value;
+};
+
+// Calls the handler the way json::detail::parser_impl does, except that
+// definite length strings and keys point into the input instead of being
+// copied, so they aren't null terminated. Indefinite length strings are
+// joined in a buffer first. Byte strings are passed to value() like text.
+//
+// Epoch times (tag 1) are passed on as numbers, bignums (tags 2 and 3) as
+// integers when they fit in 64 bits and as doubles otherwise, and decimal
+// fractions and bigfloats (tags 4 and 5) as doubles. Other tags are skipped
+// and their content is passed on.
+template <typename Handler>
+class parser_impl
+{
+public:
+    using handler_type = Handler;
+    using char_type = typename handler_type::char_type;
+    using buffer_type = std::vector<char_type>;
+
+    static_assert(sizeof(char_type) == 1, "CBOR text strings are UTF-8");
+
+    parser_impl(const unsigned char* first, const unsigned char* last,
+                handler_type& handler, std::size_t max_depth)
+        : first(first)
+        , current(first)
+        , last(last)
+        , handler(handler)
+        , max_depth(max_depth)
+    {
+    }
+
+    // parse one value
+    void parse() { parse_value(json::type_unknown, 0); }
+
+    // parse one value and check that nothing follows it
+    void parse_whole()
+    {
+        parse();
+        if (current != last)
+        {
+            throw expected_end_of_input(offset());
+        }
+    }
+
+    std::size_t offset() const
+    {
+        return static_cast<std::size_t>(current - first);
+    }
+
+    void need(std::uint64_t size)
+    {
+        if (static_cast<std::uint64_t>(last - current) < size)
+        {
+            throw unexpected_end_of_input(offset());
+        }
+    }
+
+    template <typename T>
+    T read()
+    {
+        need(sizeof(T));
+        const auto value = ::native::detail::load_big_endian<T>(current);
+        current += sizeof(T);
+        return value;
+    }
+
+    bool at_break()
+    {
+        need(1);
+        if (*current == break_code)
+        {
+            ++current;
+            return true;
+        }
+        return false;
+    }
+
+    // the count, length or value that follows the initial byte
+    std::uint64_t read_argument(std::uint8_t info)
+    {
+        switch (info)
+        {
+            case info_uint8:
+                return read<std::uint8_t>();
+            case info_uint16:
+                return read<std::uint16_t>();
+            case info_uint32:
+                return read<std::uint32_t>();
+            case info_uint64:
+                return read<std::uint64_t>();
+        }
+        if (info > info_uint64)
+        {
+            throw invalid_type(offset() - 1);
+        }
+        return info;
+    }
+
+    void parse_value(json::data_type expected_type, std::size_t depth)
+    {
+        const auto initial = read<std::uint8_t>();
+        const auto major = static_cast<major_type>(initial >> 5);
+        const auto info = static_cast<std::uint8_t>(initial & 0x1f);
+
+        switch (major)
+        {
+            case major_unsigned:
+                parse_integer(read_argument(info), expected_type);
+                return;
+            case major_negative:
+                parse_negative(read_argument(info), expected_type);
+                return;
+            case major_bytes:
+            case major_text:
+            {
+                const auto str = parse_string(major, info, string_buffer);
+                handler.value(str.first, str.second);
+                return;
+            }
+            case major_array:
+                parse_array(info, depth);
+                return;
+            case major_map:
+                parse_map(info, depth);
+                return;
+            case major_tag:
+                parse_tag(read_argument(info), expected_type, depth);
+                return;
+            case major_simple:
+                parse_simple(info, expected_type);
+                return;
+        }
+    }
+
+    // A definite length string is left in the input; an indefinite length
+    // one is joined into buffer.
+    std::pair<const char_type*, std::size_t>
+    parse_string(major_type major, std::uint8_t info, buffer_type& buffer)
+    {
+        if (info != info_indefinite)
+        {
+            const auto size = read_argument(info);
+            need(size);
+            const auto* data = reinterpret_cast<const char_type*>(current);
+            current += size;
+            return {data, static_cast<std::size_t>(size)};
+        }
+
+        buffer.clear();
+        while (!at_break())
+        {
+            const auto initial = read<std::uint8_t>();
+            if (initial >> 5 != major || (initial & 0x1f) == info_indefinite)
+            {
+                throw invalid_string_chunk(offset() - 1);
+            }
+            const auto size = read_argument(initial & 0x1f);
+            need(size);
+            buffer.insert(buffer.end(), current, current + size);
+            current += size;
+        }
+        if (buffer.empty())
+        {
+            return {reinterpret_cast<const char_type*>(current), 0};
+        }
+        return {buffer.data(), buffer.size()};
+    }
+
+    std::pair<const char_type*, std::size_t> parse_key()
+    {
+        const auto initial = read<std::uint8_t>();
+        if (initial >> 5 != major_text)
+        {
+            throw expected_string_key(offset() - 1);
+        }
+        return parse_string(major_text, initial & 0x1f, key_buffer);
+    }
+
+    void check_depth(std::size_t depth)
+    {
+        if (depth == max_depth)
+        {
+            throw nesting_too_deep(offset());
+        }
+    }
+
+    // Counts aren't trusted for reserving anything, so a bad one just runs
+    // into the end of the input.
+    void parse_array(std::uint8_t info, std::size_t depth)
+    {
+        check_depth(depth);
+
+        const bool indefinite = info == info_indefinite;
+        auto size = indefinite ? 0 : read_argument(info);
+        const auto expected_type = handler.start_array();
+        while (indefinite ? !at_break() : size-- > 0)
+        {
+            parse_value(expected_type, depth + 1);
+        }
+        handler.end_array();
+    }
+
+    void parse_map(std::uint8_t info, std::size_t depth)
+    {
+        check_depth(depth);
+
+        const bool indefinite = info == info_indefinite;
+        auto size = indefinite ? 0 : read_argument(info);
+        handler.start_object();
+        while (indefinite ? !at_break() : size-- > 0)
+        {
+            const auto key = parse_key();
+            const auto expected_type = handler.key(key.first, key.second);
+            parse_value(expected_type, depth + 1);
+        }
+        handler.end_object();
+    }
+
+    // Tags count towards the depth so that a chain of them can't overflow
+    // the stack.
+    void parse_tag(std::uint64_t tag, json::data_type expected_type,
+                   std::size_t depth)
+    {
+        check_depth(depth);
+
+        switch (tag)
+        {
+            case tag_positive_bignum:
+            case tag_negative_bignum:
+            {
+                const auto position = offset();
+                const auto initial = read<std::uint8_t>();
+                if (initial >> 5 != major_bytes)
+                {
+                    throw invalid_tag_content(position);
+                }
+                const auto bytes =
+                    parse_string(major_bytes, initial & 0x1f, string_buffer);
+                parse_bignum(bytes.first, bytes.second,
+                             tag == tag_negative_bignum, expected_type);
+                return;
+            }
+            case tag_decimal_fraction:
+            case tag_bigfloat:
+                parse_fraction(tag == tag_decimal_fraction ? 10 : 2,
+                               expected_type);
+                return;
+            case tag_epoch_time: // the number is all there is
+            default:
+                parse_value(expected_type, depth + 1);
+                return;
+        }
+    }
+
+    // [exponent, mantissa] with integer or bignum elements
+    void parse_fraction(int base, json::data_type expected_type)
+    {
+        const auto position = offset();
+        if (read<std::uint8_t>() != ((major_array << 5) | 2))
+        {
+            throw invalid_tag_content(position);
+        }
+        const auto exponent = read_exponent(position);
+        const auto mantissa = read_mantissa(position);
+        parse_real(static_cast<double>(
+                       mantissa * std::pow(static_cast<long double>(base),
+                                           exponent)),
+                   expected_type);
+    }
+
+    long double read_exponent(std::size_t position)
+    {
+        const auto initial = read<std::uint8_t>();
+        const auto info = static_cast<std::uint8_t>(initial & 0x1f);
+        switch (initial >> 5)
+        {
+            case major_unsigned:
+                return static_cast<long double>(read_argument(info));
+            case major_negative:
+                return -1.0L - static_cast<long double>(read_argument(info));
+        }
+        throw invalid_tag_content(position);
+    }
+
+    long double read_mantissa(std::size_t position)
+    {
+        if (current != last && *current >> 5 == major_tag)
+        {
+            const auto tag = read_argument(read<std::uint8_t>() & 0x1f);
+            const auto initial = read<std::uint8_t>();
+            if ((tag != tag_positive_bignum && tag != tag_negative_bignum) ||
+                initial >> 5 != major_bytes)
+            {
+                throw invalid_tag_content(position);
+            }
+            const auto bytes =
+                parse_string(major_bytes, initial & 0x1f, string_buffer);
+            const auto value = bignum_value(bytes.first, bytes.second);
+            return tag == tag_negative_bignum ? -1.0L - value : value;
+        }
+        return read_exponent(position);
+    }
+
+    static long double bignum_value(const char_type* data, std::size_t size)
+    {
+        long double value = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            value = value * 256 + static_cast<unsigned char>(data[i]);
+        }
+        return value;
+    }
+
+    void parse_bignum(const char_type* data, std::size_t size, bool negative,
+                      json::data_type expected_type)
+    {
+        while (size > 0 && *data == 0)
+        {
+            ++data;
+            --size;
+        }
+
+        if (size <= sizeof(std::uint64_t))
+        {
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                value = (value << 8) | static_cast<unsigned char>(data[i]);
+            }
+            if (negative)
+            {
+                parse_negative(value, expected_type);
+            }
+            else
+            {
+                parse_integer(value, expected_type);
+            }
+            return;
+        }
+
+        const auto value = bignum_value(data, size);
+        parse_too_big(static_cast<double>(negative ? -1.0L - value : value),
+                      expected_type);
+    }
+
+    // -1 - value, which may not fit in 64 bits
+    void parse_negative(std::uint64_t value, json::data_type expected_type)
+    {
+        if (value <= static_cast<std::uint64_t>(
+                         std::numeric_limits<std::int64_t>::max()))
+        {
+            parse_integer(-1 - static_cast<std::int64_t>(value),
+                          expected_type);
+        }
+        else
+        {
+            parse_too_big(-1.0 - static_cast<double>(value), expected_type);
+        }
+    }
+
+    // An integer that's too big for any integer type is passed as a double.
+    void parse_too_big(double value, json::data_type expected_type)
+    {
+        switch (expected_type)
+        {
+            case json::type_short:
+            case json::type_unsigned_short:
+            case json::type_int:
+            case json::type_long:
+            case json::type_long_long:
+            case json::type_unsigned:
+            case json::type_unsigned_long:
+            case json::type_unsigned_long_long:
+                throw number_too_big_for_expected_type(offset());
+            default:
+                parse_real(value, expected_type);
+        }
+    }
+
+    void parse_simple(std::uint8_t info, json::data_type expected_type)
+    {
+        switch (info)
+        {
+            case 20:
+                handler.value(false);
+                return;
+            case 21:
+                handler.value(true);
+                return;
+            case 22: // null
+            case 23: // undefined
+                handler.value(nullptr);
+                return;
+            case info_uint16:
+                parse_real(half_to_double(read<std::uint16_t>()),
+                           expected_type);
+                return;
+            case info_uint32:
+                parse_real(::native::detail::float_from_bits(
+                               read<std::uint32_t>()),
+                           expected_type);
+                return;
+            case info_uint64:
+                parse_real(::native::detail::double_from_bits(
+                               read<std::uint64_t>()),
+                           expected_type);
+                return;
+            case info_indefinite:
+                throw unexpected_break(offset() - 1);
+            default: // unassigned simple values
+                throw invalid_type(offset() - 1);
+        }
+    }
+
+    // value is a std::uint64_t, or a negative std::int64_t
+    template <typename T>
+    void parse_integer(T value, json::data_type expected_type)
+    {
+        ::native::detail::typed_integer<number_errors>(handler, value,
+                                                       expected_type, offset());
+    }
+
+    void parse_real(double value, json::data_type expected_type)
+    {
+        ::native::detail::typed_real<number_errors>(handler, value,
+                                                    expected_type, offset());
+    }
+
+    const unsigned char* first;
+    const unsigned char* current;
+    const unsigned char* last;
+    handler_type& handler;
+    std::size_t max_depth;
+    buffer_type key_buffer;
+    buffer_type string_buffer;
+};
+
+} // namespace detail
+} // namespace cbor
+} // namespace native
+
+#endif
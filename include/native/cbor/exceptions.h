@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_CBOR_EXCEPTIONS_H__
+#define NATIVE_CBOR_EXCEPTIONS_H__
+
+#include "native/config.h"
+
+#include "native/detail/offset_exception.h"
+
+namespace native
+{
+namespace cbor
+{
+
+struct cbor_exception : public ::native::detail::offset_exception
+{
+    using offset_exception::offset_exception;
+};
+
+#define NATIVE_CBOR_EXCEPTION_DECL(className, messageText)                     \
+    NATIVE_OFFSET_EXCEPTION_DECL(cbor_exception, className, messageText)
+
+NATIVE_CBOR_EXCEPTION_DECL(unexpected_end_of_input, "Unexpected end of input")
+NATIVE_CBOR_EXCEPTION_DECL(expected_end_of_input, "Expected end of input")
+NATIVE_CBOR_EXCEPTION_DECL(invalid_type, "Invalid type")
+NATIVE_CBOR_EXCEPTION_DECL(unexpected_break, "Unexpected break")
+NATIVE_CBOR_EXCEPTION_DECL(invalid_string_chunk,
+                           "Invalid chunk in an indefinite length string")
+NATIVE_CBOR_EXCEPTION_DECL(invalid_tag_content, "Invalid content for tag")
+NATIVE_CBOR_EXCEPTION_DECL(expected_string_key, "Expected string key")
+NATIVE_CBOR_EXCEPTION_DECL(nesting_too_deep, "Nesting too deep")
+NATIVE_CBOR_EXCEPTION_DECL(
+    unexpected_signed_value,
+    "The number given was signed when only unsigned was expected")
+NATIVE_CBOR_EXCEPTION_DECL(
+    number_too_big_for_expected_type,
+    "The number given was too big for the expected type")
+NATIVE_CBOR_EXCEPTION_DECL(
+    unexpected_decimal_value,
+    "The number given was a decimal instead of an integer")
+}
+} // namespace native::cbor
+
+#endif
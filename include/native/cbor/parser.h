@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_CBOR_PARSER_H__
+#define NATIVE_CBOR_PARSER_H__
+
+#include "native/config.h"
+
+#include "native/detail/binary_parser.h"
+#include "native/cbor/detail/parser_impl.h"
+
+namespace native
+{
+namespace cbor
+{
+
+// Parses CBOR (RFC 8949) into the same handlers as json::parser (see
+// native/json/handler.h). Text and byte strings are passed to value(), and
+// keys to key(), as pointers into source that are NOT null terminated, so
+// source must outlive any that are kept. Map keys must be text strings.
+//
+// See native/cbor/exceptions.h for the exceptions that are thrown.
+class parser : public ::native::detail::binary_parser<detail::parser_impl>
+{
+public:
+    using binary_parser::binary_parser;
+};
+
+} // namespace cbor
+} // namespace native
+
+#endif
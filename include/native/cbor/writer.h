@@ -0,0 +1,374 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_CBOR_WRITER_H__
+#define NATIVE_CBOR_WRITER_H__
+
+#include "native/config.h"
+
+#include "native/string_base.h"
+
+#include "native/detail/big_endian.h"
+#include "native/json/detail/inline_stack.h"
+#include "native/json/static_key.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace native
+{
+namespace cbor
+{
+
+// Writes CBOR (RFC 8949) to Stream with the same methods as json::writer, so
+// the two can be swapped. When open_array() or open_object() are given the
+// number of elements, the container has a definite length. Otherwise it has
+// an indefinite length and is ended with a break when it is closed, so
+// nothing is ever buffered.
+//
+// Integers, lengths and counts use the shortest encoding, and a double is
+// written as a float when that loses nothing.
+template <typename Stream>
+class writer
+{
+public:
+    explicit writer(Stream& ostr);
+
+    void open_array();
+    void open_array(std::size_t size);
+    void close_array();
+
+    template <typename T>
+    void append(T&& value);
+
+    // A byte string, which JSON has nothing like.
+    void append_bytes(const void* data, std::size_t length);
+
+    // Tags the value appended next, e.g. 1 before an epoch time.
+    void tag(std::uint64_t number);
+
+    void open_object();
+    void open_object(std::size_t size);
+    void close_object();
+
+    template <typename T>
+    void key(T&& key);
+
+    template <typename T, typename U>
+    void append(T&& key, U&& value);
+
+private:
+    struct state
+    {
+        bool indefinite; // ended with a break
+    };
+
+    void _open(std::uint8_t major);
+    void _open(std::uint8_t major, std::size_t size);
+    void _close();
+
+    void _put(std::uint8_t ch);
+    void _write_head(std::uint8_t major, std::uint64_t argument);
+    template <typename T>
+    void _write_big_endian(std::uint8_t initial, T value);
+
+    void _write_key(const json::static_key& key);
+    template <typename T>
+    void _write_key(const T& key);
+
+    void _write(std::nullptr_t);
+    void _write(bool value);
+    void _write(const char* value);
+    void _write_string(const char* s, std::size_t length);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value &&
+                                std::is_signed<T>::value,
+                            void>::type
+    _write(T value);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value &&
+                                !std::is_signed<T>::value,
+                            void>::type
+    _write(T value);
+    void _write(float value);
+    void _write(double value);
+    void _write(long double value);
+    template <typename T>
+    typename std::enable_if<is_string_class<T>::value, void>::type
+    _write(const T& value);
+
+    Stream& _ostr;
+    json::detail::inline_stack<state, 32> _state;
+};
+
+template <typename Stream>
+writer<Stream>::writer(Stream& ostr)
+    : _ostr(ostr)
+{
+}
+
+template <typename Stream>
+void writer<Stream>::open_array()
+{
+    _open(4);
+}
+
+template <typename Stream>
+void writer<Stream>::open_array(std::size_t size)
+{
+    _open(4, size);
+}
+
+template <typename Stream>
+void writer<Stream>::close_array()
+{
+    _close();
+}
+
+template <typename Stream>
+void writer<Stream>::open_object()
+{
+    _open(5);
+}
+
+template <typename Stream>
+void writer<Stream>::open_object(std::size_t size)
+{
+    _open(5, size);
+}
+
+template <typename Stream>
+void writer<Stream>::close_object()
+{
+    _close();
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::append(T&& value)
+{
+    _write(value);
+}
+
+template <typename Stream>
+void writer<Stream>::append_bytes(const void* data, std::size_t length)
+{
+    _write_head(2, length);
+    _ostr.write(static_cast<const char*>(data), length);
+}
+
+template <typename Stream>
+void writer<Stream>::tag(std::uint64_t number)
+{
+    _write_head(6, number);
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::key(T&& key)
+{
+    _write_key(key);
+}
+
+template <typename Stream>
+template <typename T, typename U>
+void writer<Stream>::append(T&& label, U&& value)
+{
+    key(label);
+    append(value);
+}
+
+template <typename Stream>
+void writer<Stream>::_open(std::uint8_t major)
+{
+    _put(static_cast<std::uint8_t>(major << 5 | 31));
+    _state.push_back(state{true});
+}
+
+template <typename Stream>
+void writer<Stream>::_open(std::uint8_t major, std::size_t size)
+{
+    _write_head(major, size);
+    _state.push_back(state{false});
+}
+
+template <typename Stream>
+void writer<Stream>::_close()
+{
+    if (_state.empty())
+    {
+        return;
+    }
+
+    if (_state.back().indefinite)
+    {
+        _put(0xff);
+    }
+    _state.pop_back();
+}
+
+template <typename Stream>
+inline void writer<Stream>::_put(std::uint8_t ch)
+{
+    _ostr.put(static_cast<char>(ch));
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::_write_big_endian(std::uint8_t initial, T value)
+{
+    unsigned char buffer[1 + sizeof(T)];
+    buffer[0] = initial;
+    ::native::detail::store_big_endian(value, buffer + 1);
+    _ostr.write(reinterpret_cast<const char*>(buffer), sizeof(buffer));
+}
+
+// The initial byte and the shortest argument that holds the value.
+template <typename Stream>
+void writer<Stream>::_write_head(std::uint8_t major, std::uint64_t argument)
+{
+    const auto initial = static_cast<std::uint8_t>(major << 5);
+    if (argument < 24)
+    {
+        _put(static_cast<std::uint8_t>(initial | argument));
+    }
+    else if (argument <= 0xff)
+    {
+        _write_big_endian(initial | 24, static_cast<std::uint8_t>(argument));
+    }
+    else if (argument <= 0xffff)
+    {
+        _write_big_endian(initial | 25, static_cast<std::uint16_t>(argument));
+    }
+    else if (argument <= 0xffffffff)
+    {
+        _write_big_endian(initial | 26, static_cast<std::uint32_t>(argument));
+    }
+    else
+    {
+        _write_big_endian(initial | 27, argument);
+    }
+}
+
+// Static keys are quoted and followed by a colon for JSON.
+template <typename Stream>
+void writer<Stream>::_write_key(const json::static_key& key)
+{
+    _write_string(key.data() + 1, key.size() - 3);
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::_write_key(const T& key)
+{
+    _write(key);
+}
+
+template <typename Stream>
+void writer<Stream>::_write(std::nullptr_t)
+{
+    _put(0xf6);
+}
+
+template <typename Stream>
+void writer<Stream>::_write(bool value)
+{
+    _put(value ? 0xf5 : 0xf4);
+}
+
+template <typename Stream>
+void writer<Stream>::_write(const char* value)
+{
+    _write_string(value, std::strlen(value));
+}
+
+template <typename Stream>
+template <typename T>
+typename std::enable_if<is_string_class<T>::value, void>::type
+writer<Stream>::_write(const T& value)
+{
+    _write_string(value.data(), value.size());
+}
+
+template <typename Stream>
+void writer<Stream>::_write_string(const char* s, std::size_t length)
+{
+    _write_head(3, length);
+    _ostr.write(s, length);
+}
+
+template <typename Stream>
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                            !std::is_signed<T>::value,
+                        void>::type
+writer<Stream>::_write(T value)
+{
+    _write_head(0, static_cast<std::uint64_t>(value));
+}
+
+// Negative integers are stored as -1 - n.
+template <typename Stream>
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                            std::is_signed<T>::value,
+                        void>::type
+writer<Stream>::_write(T value)
+{
+    const auto number = static_cast<std::int64_t>(value);
+    if (number >= 0)
+    {
+        _write_head(0, static_cast<std::uint64_t>(number));
+    }
+    else
+    {
+        _write_head(1, ~static_cast<std::uint64_t>(number));
+    }
+}
+
+template <typename Stream>
+void writer<Stream>::_write(float value)
+{
+    _write_big_endian(0xfa, ::native::detail::float_bits(value));
+}
+
+template <typename Stream>
+void writer<Stream>::_write(double value)
+{
+    if (std::fabs(value) <= std::numeric_limits<float>::max() &&
+        static_cast<double>(static_cast<float>(value)) == value)
+    {
+        _write(static_cast<float>(value));
+    }
+    else
+    {
+        _write_big_endian(0xfb, ::native::detail::double_bits(value));
+    }
+}
+
+template <typename Stream>
+void writer<Stream>::_write(long double value)
+{
+    _write(static_cast<double>(value));
+}
+
+} // namespace cbor
+} // namespace native
+
+#endif
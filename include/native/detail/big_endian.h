@@ -0,0 +1,88 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_DETAIL_BIG_ENDIAN_H__
+#define NATIVE_DETAIL_BIG_ENDIAN_H__
+
+#include "native/config.h"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace native
+{
+namespace detail
+{
+
+// Read and write unsigned integers in network byte order. Compilers turn the
+// shifts into a byte swap where there is one.
+template <typename T>
+inline T load_big_endian(const unsigned char* p)
+{
+    static_assert(std::is_unsigned<T>::value, "unsigned types only");
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+    {
+        value = static_cast<T>((value << 8) | p[i]);
+    }
+    return value;
+}
+
+template <typename T>
+inline void store_big_endian(T value, unsigned char* p)
+{
+    static_assert(std::is_unsigned<T>::value, "unsigned types only");
+    for (std::size_t i = sizeof(T); i-- > 0;)
+    {
+        p[i] = static_cast<unsigned char>(value);
+        value = static_cast<T>(value >> 8);
+    }
+}
+
+// The bits of a float or double, to send them big endian too.
+inline std::uint32_t float_bits(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline std::uint64_t double_bits(double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float float_from_bits(std::uint32_t bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline double double_from_bits(std::uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // namespace detail
+} // namespace native
+
+#endif
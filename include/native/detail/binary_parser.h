@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_DETAIL_BINARY_PARSER_H__
+#define NATIVE_DETAIL_BINARY_PARSER_H__
+
+#include "native/config.h"
+
+#include <cstddef>
+
+namespace native
+{
+namespace detail
+{
+
+// What the binary parsers have in common, around Impl, the format's
+// parser_impl.
+template <template <typename> class Impl>
+class binary_parser
+{
+public:
+    static constexpr std::size_t default_max_depth = 1024;
+
+    // Containers nested deeper than max_depth throw nesting_too_deep.
+    explicit binary_parser(std::size_t max_depth = default_max_depth)
+        : _max_depth(max_depth)
+    {
+    }
+
+    // Parses one value that takes up all of source.
+    template <typename Handler>
+    void parse(const char* source, std::size_t length, Handler& handler) const
+    {
+        const auto* first = reinterpret_cast<const unsigned char*>(source);
+        Impl<Handler> parser{first, first + length, handler, _max_depth};
+        parser.parse_whole();
+    }
+
+    template <typename Handler, typename String>
+    void parse(const String& source, Handler& handler) const
+    {
+        parse(source.data(), source.size(), handler);
+    }
+
+    // Parses the value at the front of source and returns its size, for
+    // reading consecutive messages.
+    template <typename Handler>
+    std::size_t parse_prefix(const char* source, std::size_t length,
+                             Handler& handler) const
+    {
+        const auto* first = reinterpret_cast<const unsigned char*>(source);
+        Impl<Handler> parser{first, first + length, handler, _max_depth};
+        parser.parse();
+        return parser.offset();
+    }
+
+private:
+    std::size_t _max_depth;
+};
+
+} // namespace detail
+} // namespace native
+
+#endif
@@ -313,22 +313,45 @@ inline std::uint32_t digits10(uint64_t v)
 
 inline std::uint32_t uint64_to_buffer_unsafe(uint64_t v, char* const buffer)
 {
+    // clang-format off
+    static const char digit_pairs[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+    // clang-format on
+
     auto const result = digits10(v);
     // WARNING: using size_t or pointer arithmetic for pos slows down
     // the loop below 20x. This is because several 32-bit ops can be
     // done in parallel, but only fewer 64-bit ones.
     std::uint32_t pos = result - 1;
-    while (v >= 10)
+    // Two digits at a time halves the number of divisions.
+    while (v >= 100)
     {
-        // Keep these together so a peephole optimization "sees" them and
-        // computes them in one shot.
-        auto const q = v / 10;
-        auto const r = static_cast<std::uint32_t>(v % 10);
-        buffer[pos--] = '0' + r;
+        auto const q = v / 100;
+        auto const r = static_cast<std::uint32_t>(v % 100) * 2;
+        buffer[pos] = digit_pairs[r + 1];
+        buffer[pos - 1] = digit_pairs[r];
+        pos -= 2;
         v = q;
     }
-    // Last digit is trivial to handle
-    buffer[pos] = static_cast<std::uint32_t>(v) + '0';
+    if (v >= 10)
+    {
+        auto const r = static_cast<std::uint32_t>(v) * 2;
+        buffer[pos] = digit_pairs[r + 1];
+        buffer[pos - 1] = digit_pairs[r];
+    }
+    else
+    {
+        buffer[pos] = static_cast<std::uint32_t>(v) + '0';
+    }
     return result;
 }
 
@@ -405,11 +428,12 @@ typename std::enable_if<std::is_integral<Source>::value &&
                         sizeof(Source) >= 4>::type
 stream_append(Stream& stream, Source value)
 {
-    char buffer[20];
+    char buffer[21];
     if (value < 0)
     {
-        stream.put('-');
-        stream.write(buffer, uint64_to_buffer_unsafe(-uint64_t(value), buffer));
+        buffer[0] = '-';
+        stream.write(buffer, 1 + uint64_to_buffer_unsafe(-uint64_t(value),
+                                                         buffer + 1));
     }
     else
     {
@@ -0,0 +1,60 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_DETAIL_OFFSET_EXCEPTION_H__
+#define NATIVE_DETAIL_OFFSET_EXCEPTION_H__
+
+#include "native/config.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace native
+{
+namespace detail
+{
+
+// Base of the exceptions thrown by the binary parsers, which report where
+// in the input an error was found as a byte offset.
+struct offset_exception : public std::runtime_error
+{
+    offset_exception(const std::string& message, std::size_t offset)
+        : std::runtime_error{message + ". Offset " + std::to_string(offset) +
+                             "."}
+        , _offset(offset)
+    {
+    }
+
+    // Where in the input the error was found.
+    std::size_t offset() const { return _offset; }
+
+private:
+    std::size_t _offset;
+};
+
+} // namespace detail
+} // namespace native
+
+#define NATIVE_OFFSET_EXCEPTION_DECL(baseName, className, messageText)         \
+    struct className : baseName                                                \
+    {                                                                          \
+        className(std::size_t offset)                                          \
+            : baseName{messageText, offset}                                    \
+        {                                                                      \
+        }                                                                      \
+    };
+
+#endif
@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_DETAIL_TYPED_VALUE_H__
+#define NATIVE_DETAIL_TYPED_VALUE_H__
+
+#include "native/config.h"
+
+#include "native/json/types.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace native
+{
+namespace detail
+{
+
+// Passes numbers read by the binary parsers to a handler the way
+// json::detail::parser_impl does: converted to the type key() or
+// start_array() said to expect, and otherwise as the smallest of 32 or 64
+// bits that holds them. Errors names the parser's exceptions,
+// number_too_big_for_expected_type, unexpected_signed_value and
+// unexpected_decimal_value, which are thrown with offset.
+
+template <typename T, typename Errors>
+T narrow(std::uint64_t value, std::size_t offset)
+{
+    if (value > static_cast<unsigned long long>(std::numeric_limits<T>::max()))
+    {
+        throw typename Errors::number_too_big_for_expected_type(offset);
+    }
+    return static_cast<T>(value);
+}
+
+template <typename T, typename Errors>
+T narrow(std::int64_t value, std::size_t offset)
+{
+    if (!std::numeric_limits<T>::is_signed)
+    {
+        throw typename Errors::unexpected_signed_value(offset);
+    }
+    if (value < static_cast<long long>(std::numeric_limits<T>::min()))
+    {
+        throw typename Errors::number_too_big_for_expected_type(offset);
+    }
+    return static_cast<T>(value);
+}
+
+// 32 bits if it fits, otherwise 64, like the JSON parser
+template <typename Handler>
+void typed_unknown_integer(Handler& handler, std::uint64_t value)
+{
+    if (value <= std::numeric_limits<std::uint32_t>::max())
+    {
+        handler.value(static_cast<std::uint32_t>(value));
+    }
+    else
+    {
+        handler.value(value);
+    }
+}
+
+template <typename Handler>
+void typed_unknown_integer(Handler& handler, std::int64_t value)
+{
+    if (value >= std::numeric_limits<std::int32_t>::min())
+    {
+        handler.value(static_cast<std::int32_t>(value));
+    }
+    else
+    {
+        handler.value(value);
+    }
+}
+
+// value is a std::uint64_t, or a negative std::int64_t
+template <typename Errors, typename Handler, typename T>
+void typed_integer(Handler& handler, T value, json::data_type expected_type,
+                   std::size_t offset)
+{
+    switch (expected_type)
+    {
+        case json::type_short:
+            handler.value(narrow<short, Errors>(value, offset));
+            return;
+        case json::type_unsigned_short:
+            handler.value(narrow<unsigned short, Errors>(value, offset));
+            return;
+        case json::type_int:
+            handler.value(narrow<int, Errors>(value, offset));
+            return;
+        case json::type_long:
+            handler.value(narrow<long, Errors>(value, offset));
+            return;
+        case json::type_long_long:
+            handler.value(narrow<long long, Errors>(value, offset));
+            return;
+        case json::type_unsigned:
+            handler.value(narrow<unsigned, Errors>(value, offset));
+            return;
+        case json::type_unsigned_long:
+            handler.value(narrow<unsigned long, Errors>(value, offset));
+            return;
+        case json::type_unsigned_long_long:
+            handler.value(narrow<unsigned long long, Errors>(value, offset));
+            return;
+        case json::type_float:
+            handler.value(static_cast<float>(value));
+            return;
+        case json::type_double:
+            handler.value(static_cast<double>(value));
+            return;
+        case json::type_long_double:
+            handler.value(static_cast<long double>(value));
+            return;
+        case json::type_object:
+        case json::type_array:
+        case json::type_string:
+        case json::type_bool:
+            return; // unexpected type, skipped like the JSON parser does
+        case json::type_number: // there is no text to pass on
+        case json::type_unknown:
+            break;
+    }
+
+    typed_unknown_integer(handler, value);
+}
+
+template <typename Errors, typename Handler>
+void typed_real(Handler& handler, double value, json::data_type expected_type,
+                std::size_t offset)
+{
+    switch (expected_type)
+    {
+        case json::type_short:
+        case json::type_unsigned_short:
+        case json::type_int:
+        case json::type_long:
+        case json::type_long_long:
+        case json::type_unsigned:
+        case json::type_unsigned_long:
+        case json::type_unsigned_long_long:
+            throw typename Errors::unexpected_decimal_value(offset);
+        case json::type_float:
+            handler.value(static_cast<float>(value));
+            return;
+        case json::type_long_double:
+            handler.value(static_cast<long double>(value));
+            return;
+        case json::type_object:
+        case json::type_array:
+        case json::type_string:
+        case json::type_bool:
+            return; // unexpected type, skipped like the JSON parser does
+        case json::type_double:
+        case json::type_number: // there is no text to pass on
+        case json::type_unknown:
+            break;
+    }
+    handler.value(value);
+}
+
+} // namespace detail
+} // namespace native
+
+#endif
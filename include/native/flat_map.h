@@ -0,0 +1,481 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_FLAT_MAP_H__
+#define NATIVE_FLAT_MAP_H__
+
+#include "native/config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace native
+{
+
+// A map that keeps its items in one vector, in the order they were inserted.
+//
+// Small maps are searched linearly, which for a handful of keys beats hashing
+// and keeps every item in a few cache lines. Once a map holds more than
+// linear_size items it also keeps an open addressed table of positions, so
+// lookups stay O(1). Erasing is O(n) since the items after it are moved down.
+//
+// Keys must not be changed through an iterator. Hash and KeyEqual are default
+// constructed where they are needed.
+template <typename Key, typename T, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<Key, T>>>
+class flat_map
+{
+    template <typename U>
+    using rebind_alloc =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<U>;
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using size_type = std::size_t;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+
+private:
+    using items_type = std::vector<value_type, rebind_alloc<value_type>>;
+    using index_type = std::vector<std::uint32_t, rebind_alloc<std::uint32_t>>;
+
+public:
+    using iterator = typename items_type::iterator;
+    using const_iterator = typename items_type::const_iterator;
+
+    static constexpr size_type linear_size = 8;
+
+    flat_map() = default;
+    flat_map(std::initializer_list<value_type> items);
+    template <typename InputIterator>
+    flat_map(InputIterator first, InputIterator last);
+
+    iterator begin() noexcept { return _items.begin(); }
+    const_iterator begin() const noexcept { return _items.begin(); }
+    const_iterator cbegin() const noexcept { return _items.cbegin(); }
+
+    iterator end() noexcept { return _items.end(); }
+    const_iterator end() const noexcept { return _items.end(); }
+    const_iterator cend() const noexcept { return _items.cend(); }
+
+    bool empty() const noexcept { return _items.empty(); }
+    size_type size() const noexcept { return _items.size(); }
+
+    void reserve(size_type n);
+    void clear() noexcept;
+
+    T& operator[](const Key& key);
+    T& operator[](Key&& key);
+
+    // Throws std::out_of_range if key isn't in the map.
+    T& at(const Key& key);
+    const T& at(const Key& key) const;
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    size_type count(const Key& key) const;
+
+    // Does nothing if the key is already in the map.
+    std::pair<iterator, bool> insert(const value_type& value);
+    std::pair<iterator, bool> insert(value_type&& value);
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+
+    iterator erase(const_iterator position);
+    size_type erase(const Key& key);
+
+    void swap(flat_map& right) noexcept;
+
+private:
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    size_type _position(const Key& key) const;
+    std::pair<iterator, bool> _insert(value_type&& value);
+
+    void _reindex(size_type size);
+    void _index(size_type position);
+    void _unindex(size_type position);
+
+    items_type _items;
+
+    // Positions plus one, or zero for an empty slot. Empty until the map
+    // grows past linear_size.
+    index_type _table;
+};
+
+// Two maps are equal if they have the same items, in any order.
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool operator==(const flat_map<Key, T, Hash, KeyEqual, Allocator>& left,
+                const flat_map<Key, T, Hash, KeyEqual, Allocator>& right);
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool operator!=(const flat_map<Key, T, Hash, KeyEqual, Allocator>& left,
+                const flat_map<Key, T, Hash, KeyEqual, Allocator>& right);
+
+//
+// implementation
+//
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+flat_map<Key, T, Hash, KeyEqual, Allocator>::flat_map(
+    std::initializer_list<value_type> items)
+    : flat_map(items.begin(), items.end())
+{
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+template <typename InputIterator>
+flat_map<Key, T, Hash, KeyEqual, Allocator>::flat_map(InputIterator first,
+                                                      InputIterator last)
+{
+    for (; first != last; ++first)
+    {
+        insert(*first);
+    }
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+void flat_map<Key, T, Hash, KeyEqual, Allocator>::reserve(size_type n)
+{
+    _items.reserve(n);
+    if (n > linear_size)
+    {
+        _reindex(n);
+    }
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+void flat_map<Key, T, Hash, KeyEqual, Allocator>::clear() noexcept
+{
+    _items.clear();
+    _table.clear();
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+T& flat_map<Key, T, Hash, KeyEqual, Allocator>::operator[](const Key& key)
+{
+    const auto position = _position(key);
+    if (position != npos)
+    {
+        return _items[position].second;
+    }
+    return _insert(value_type{key, T{}}).first->second;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+T& flat_map<Key, T, Hash, KeyEqual, Allocator>::operator[](Key&& key)
+{
+    const auto position = _position(key);
+    if (position != npos)
+    {
+        return _items[position].second;
+    }
+    return _insert(value_type{std::move(key), T{}}).first->second;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+T& flat_map<Key, T, Hash, KeyEqual, Allocator>::at(const Key& key)
+{
+    const auto position = _position(key);
+    if (position == npos)
+    {
+        throw std::out_of_range("flat_map::at key not found");
+    }
+    return _items[position].second;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+const T& flat_map<Key, T, Hash, KeyEqual, Allocator>::at(const Key& key) const
+{
+    const auto position = _position(key);
+    if (position == npos)
+    {
+        throw std::out_of_range("flat_map::at key not found");
+    }
+    return _items[position].second;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename flat_map<Key, T, Hash, KeyEqual, Allocator>::iterator
+flat_map<Key, T, Hash, KeyEqual, Allocator>::find(const Key& key)
+{
+    const auto position = _position(key);
+    return position == npos ? _items.end() : _items.begin() + position;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename flat_map<Key, T, Hash, KeyEqual, Allocator>::const_iterator
+flat_map<Key, T, Hash, KeyEqual, Allocator>::find(const Key& key) const
+{
+    const auto position = _position(key);
+    return position == npos ? _items.end() : _items.begin() + position;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename flat_map<Key, T, Hash, KeyEqual, Allocator>::size_type
+flat_map<Key, T, Hash, KeyEqual, Allocator>::count(const Key& key) const
+{
+    return _position(key) == npos ? 0 : 1;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+std::pair<typename flat_map<Key, T, Hash, KeyEqual, Allocator>::iterator, bool>
+flat_map<Key, T, Hash, KeyEqual, Allocator>::insert(const value_type& value)
+{
+    const auto position = _position(value.first);
+    if (position != npos)
+    {
+        return {_items.begin() + position, false};
+    }
+    return _insert(value_type{value});
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+std::pair<typename flat_map<Key, T, Hash, KeyEqual, Allocator>::iterator, bool>
+flat_map<Key, T, Hash, KeyEqual, Allocator>::insert(value_type&& value)
+{
+    const auto position = _position(value.first);
+    if (position != npos)
+    {
+        return {_items.begin() + position, false};
+    }
+    return _insert(std::move(value));
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+template <typename... Args>
+std::pair<typename flat_map<Key, T, Hash, KeyEqual, Allocator>::iterator, bool>
+flat_map<Key, T, Hash, KeyEqual, Allocator>::emplace(Args&&... args)
+{
+    return insert(value_type(std::forward<Args>(args)...));
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename flat_map<Key, T, Hash, KeyEqual, Allocator>::iterator
+flat_map<Key, T, Hash, KeyEqual, Allocator>::erase(const_iterator position)
+{
+    const auto offset = position - _items.cbegin();
+    if (_items.size() - 1 > linear_size)
+    {
+        _unindex(static_cast<size_type>(offset));
+    }
+    else
+    {
+        _table.clear();
+    }
+    _items.erase(_items.begin() + offset);
+    return _items.begin() + offset;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename flat_map<Key, T, Hash, KeyEqual, Allocator>::size_type
+flat_map<Key, T, Hash, KeyEqual, Allocator>::erase(const Key& key)
+{
+    const auto position = _position(key);
+    if (position == npos)
+    {
+        return 0;
+    }
+    erase(_items.cbegin() + position);
+    return 1;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+void flat_map<Key, T, Hash, KeyEqual, Allocator>::swap(flat_map& right) noexcept
+{
+    _items.swap(right._items);
+    _table.swap(right._table);
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+typename flat_map<Key, T, Hash, KeyEqual, Allocator>::size_type
+flat_map<Key, T, Hash, KeyEqual, Allocator>::_position(const Key& key) const
+{
+    if (_table.empty())
+    {
+        for (size_type i = 0; i < _items.size(); ++i)
+        {
+            if (KeyEqual{}(_items[i].first, key))
+            {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    const auto mask = _table.size() - 1;
+    for (auto slot = Hash{}(key) & mask; _table[slot];
+         slot = (slot + 1) & mask)
+    {
+        const auto position = _table[slot] - 1;
+        if (KeyEqual{}(_items[position].first, key))
+        {
+            return position;
+        }
+    }
+    return npos;
+}
+
+// The key is known not to be in the map. The table is grown first so that
+// if it throws the map is unchanged.
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+std::pair<typename flat_map<Key, T, Hash, KeyEqual, Allocator>::iterator, bool>
+flat_map<Key, T, Hash, KeyEqual, Allocator>::_insert(value_type&& value)
+{
+    const auto size = _items.size() + 1;
+    if (size > linear_size && size * 2 > _table.size())
+    {
+        _reindex(size);
+    }
+
+    _items.push_back(std::move(value));
+    if (!_table.empty())
+    {
+        _index(_items.size() - 1);
+    }
+    return {_items.end() - 1, true};
+}
+
+// Rebuilds the table with room for size items at a load of at most one half.
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+void flat_map<Key, T, Hash, KeyEqual, Allocator>::_reindex(size_type size)
+{
+    size_type capacity = 16;
+    while (capacity < size * 2)
+    {
+        capacity *= 2;
+    }
+
+    index_type table(capacity);
+    _table.swap(table);
+    for (size_type i = 0; i < _items.size(); ++i)
+    {
+        _index(i);
+    }
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+void flat_map<Key, T, Hash, KeyEqual, Allocator>::_index(size_type position)
+{
+    const auto mask = _table.size() - 1;
+    auto slot = Hash{}(_items[position].first) & mask;
+    while (_table[slot])
+    {
+        slot = (slot + 1) & mask;
+    }
+    _table[slot] = static_cast<std::uint32_t>(position + 1);
+}
+
+// Removes an item about to be erased. Later entries in its probe run are
+// shifted back over the gap instead of leaving a tombstone, then the
+// positions after it are moved down by one to match the items.
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+void flat_map<Key, T, Hash, KeyEqual, Allocator>::_unindex(size_type position)
+{
+    const auto mask = _table.size() - 1;
+    const auto entry = static_cast<std::uint32_t>(position + 1);
+    auto hole = Hash{}(_items[position].first) & mask;
+    while (_table[hole] != entry)
+    {
+        hole = (hole + 1) & mask;
+    }
+
+    for (auto slot = (hole + 1) & mask; _table[slot];
+         slot = (slot + 1) & mask)
+    {
+        const auto home = Hash{}(_items[_table[slot] - 1].first) & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            _table[hole] = _table[slot];
+            hole = slot;
+        }
+    }
+    _table[hole] = 0;
+
+    for (auto& slot : _table)
+    {
+        if (slot > entry)
+        {
+            --slot;
+        }
+    }
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool operator==(const flat_map<Key, T, Hash, KeyEqual, Allocator>& left,
+                const flat_map<Key, T, Hash, KeyEqual, Allocator>& right)
+{
+    if (left.size() != right.size())
+    {
+        return false;
+    }
+
+    for (const auto& item : left)
+    {
+        const auto it = right.find(item.first);
+        if (it == right.end() || !(it->second == item.second))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator>
+bool operator!=(const flat_map<Key, T, Hash, KeyEqual, Allocator>& left,
+                const flat_map<Key, T, Hash, KeyEqual, Allocator>& right)
+{
+    return !(left == right);
+}
+
+} // namespace native
+
+#endif
@@ -344,10 +344,20 @@ public:
                 size_type n2) const;
 
     // Create a string that references a string literal. This string performs
-    // no allocations and is über efficient.
+    // no allocations and is über efficient. Its hash is the same as any other
+    // string with the same characters.
     template <size_t size>
     static constexpr basic_istring literal(const value_type (&s)[size]);
 
+    // Create a string that references the first n characters of s without
+    // copying them, like literal(). s must outlive the string and every copy
+    // of it, and c_str() is only null terminated if s[n] is a null character.
+    // A hash of the characters, from hash(), may be given so it isn't
+    // computed again.
+    static basic_istring external(const_pointer s, size_type n);
+    static basic_istring external(const_pointer s, size_type n,
+                                  size_type hash);
+
 private:
     friend basic_string_builder<Ch>;
 
@@ -390,7 +400,21 @@ template <size_t n>
 constexpr basic_istring<Ch> basic_istring<Ch>::literal(const value_type (&s)[n])
 {
     return basic_istring<Ch>(core_type(
-        s, n - 1, default_hasher::static_hash(s, n * sizeof(value_type))));
+        s, n - 1,
+        default_hasher::static_hash(s, (n - 1) * sizeof(value_type))));
+}
+
+template <typename Ch>
+basic_istring<Ch> basic_istring<Ch>::external(const_pointer s, size_type n)
+{
+    return external(s, n, ::native::hash(s, n * sizeof(value_type)));
+}
+
+template <typename Ch>
+basic_istring<Ch> basic_istring<Ch>::external(const_pointer s, size_type n,
+                                              size_type hash)
+{
+    return basic_istring<Ch>(core_type(s, n, hash));
 }
 
 // 0)
@@ -19,11 +19,24 @@
 
 #include "native/config.h"
 
+#include "native/flat_map.h"
 #include "native/istring.h"
 
+#include "native/cbor/writer.h"
+#include "native/json/arena.h"
+#include "native/json/canonical_writer.h"
 #include "native/json/conversion.h"
+#include "native/json/static_key.h"
 #include "native/json/types.h"
-
+#include "native/json/writer.h"
+#include "native/msgpack/writer.h"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -32,18 +45,163 @@ namespace native
 namespace json
 {
 
-// A JSON-like value class.
+// How basic_any stores objects.
+//
+// unordered_objects uses std::unordered_map, so members are kept in no
+// particular order and each is a separate allocation.
+struct unordered_objects
+{
+    template <typename Key, typename T, typename Allocator>
+    using map = std::unordered_map<Key, T, std::hash<Key>, std::equal_to<Key>,
+                                   Allocator>;
+};
+
+// ordered_objects uses a flat_map, which keeps members contiguous and in the
+// order they were added, so objects are cheaper to build, iterate and dump,
+// and are written in the order they were parsed.
+struct ordered_objects
+{
+    template <typename Key, typename T, typename Allocator>
+    using map = flat_map<Key, T, std::hash<Key>, std::equal_to<Key>, Allocator>;
+};
+
+namespace detail
+{
+
+// Keys that members of a basic_any object can be looked up by without making
+// a string_type first. make() gives a string_type that refers to the key's
+// characters rather than copying them, where String allows it.
+template <typename Key>
+struct lookup_key
+{
+    static constexpr bool value = false;
+};
+
 template <typename String>
+struct key_string
+{
+    static String make(const char* s, std::size_t length, std::size_t)
+    {
+        return String(s, length);
+    }
+
+    static String make(const char* s, std::size_t length)
+    {
+        return String(s, length);
+    }
+};
+
+template <>
+struct key_string<istring>
+{
+    static istring make(const char* s, std::size_t length, std::size_t hash)
+    {
+        return istring::external(s, length, hash);
+    }
+
+    static istring make(const char* s, std::size_t length)
+    {
+        return istring::external(s, length);
+    }
+};
+
+template <typename Key>
+struct lookup_string_key
+{
+    static constexpr bool value = true;
+
+    static const char* data(const Key& key) { return key.data(); }
+    static std::size_t size(const Key& key) { return key.size(); }
+
+    template <typename String>
+    static String make(const Key& key)
+    {
+        return key_string<String>::make(key.data(), key.size());
+    }
+};
+
+template <typename Key>
+struct lookup_cstring_key
+{
+    static constexpr bool value = true;
+
+    static const char* data(const Key& key) { return key; }
+    static std::size_t size(const Key& key) { return std::strlen(key); }
+
+    template <typename String>
+    static String make(const Key& key)
+    {
+        return key_string<String>::make(key, size(key));
+    }
+};
+
+// Arrays may be buffers that aren't full, so they are measured like const
+// char*. Use a hashed_key to skip that too.
+template <std::size_t N>
+struct lookup_key<char[N]> : lookup_cstring_key<char[N]>
+{
+};
+
+template <>
+struct lookup_key<const char*> : lookup_cstring_key<const char*>
+{
+};
+
+template <>
+struct lookup_key<char*> : lookup_cstring_key<char*>
+{
+};
+
+template <>
+struct lookup_key<std::string> : lookup_string_key<std::string>
+{
+};
+
+template <>
+struct lookup_key<string_slice> : lookup_string_key<string_slice>
+{
+};
+
+template <>
+struct lookup_key<hashed_key> : lookup_string_key<hashed_key>
+{
+    template <typename String>
+    static String make(const hashed_key& key)
+    {
+        return key_string<String>::make(key.data(), key.size(), key.hash());
+    }
+};
+
+} // namespace detail
+
+// A JSON-like value class. A value is 16 bytes: its type, and either a
+// bool, a long long, a double, or a pointer to a string, array or object.
+//
+// A number parsed with number_lazy is a pointer to its text instead, which
+// is converted when it is first read and written back out unchanged by
+// dump(). Its type is still json_integer or json_real.
+//
+// Arrays and objects get their memory from Allocator. With an
+// arena_allocator the whole value can live in an arena; see
+// native/json/document.h. Objects chooses how objects are stored.
+template <typename String, typename Allocator = std::allocator<char>,
+          typename Objects = unordered_objects>
 class basic_any
 {
-    using this_type = basic_any<String>;
-    using array = std::vector<this_type>;
+    using this_type = basic_any<String, Allocator, Objects>;
+    template <typename T>
+    using rebind_alloc =
+        typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using array = std::vector<this_type, rebind_alloc<this_type>>;
 
 public:
     using string_type = String;
+    using allocator_type = Allocator;
     using const_iterator = typename array::const_iterator;
     using value_type = this_type;
-    using object = std::unordered_map<string_type, this_type>;
+    using object = typename Objects::template map<
+        string_type, this_type,
+        rebind_alloc<std::pair<const string_type, this_type>>>;
     struct handler;
     struct object_key_iterator;
     struct object_value_iterator;
@@ -74,7 +232,7 @@ public:
     basic_any(long long value);
     basic_any(unsigned long long value);
 
-    // Initialize with a floating point value.
+    // Initialize with a floating point value, which is kept as a double.
     basic_any(float value);
     basic_any(double value);
     basic_any(long double value);
@@ -93,12 +251,21 @@ public:
     basic_any(const object& value);
     basic_any(object&& value);
 
+    // Moving leaves right null.
     basic_any(const basic_any& right);
     basic_any(basic_any&& right) noexcept;
 
     basic_any& operator=(const basic_any& right);
     basic_any& operator=(basic_any&& right) noexcept;
 
+    // A copy in O(1) that shares this value's strings, arrays and objects.
+    // Whichever of the two changes a shared array or object first copies it,
+    // sharing its elements, so only the path to the change is duplicated.
+    // An array or object that a mutable reference into was taken from is
+    // copied a level here rather than shared, so writing through the
+    // reference later doesn't change the copy.
+    basic_any share() const;
+
     ~basic_any();
 
     // Returns the data type of this object.
@@ -155,6 +322,10 @@ public:
     void push_back(const basic_any& value);
     void emplace_back(basic_any&& value);
 
+    // Inserts before it.
+    const_iterator insert(const_iterator it, const basic_any& value);
+    const_iterator emplace(const_iterator it, basic_any&& value);
+
     void pop_back();
 
     void resize(std::size_t n, const basic_any& defaultValue = nullptr);
@@ -171,6 +342,22 @@ public:
 
     typename object::const_iterator find(const string_type& key) const;
 
+    // Lookups by a string literal, const char*, std::string, string_slice or
+    // hashed_key, without making a string_type unless a member is added.
+    // A hashed_key's characters aren't hashed at all.
+    template <typename Key>
+    typename std::enable_if<detail::lookup_key<Key>::value, basic_any&>::type
+    operator[](const Key& key);
+    template <typename Key>
+    typename std::enable_if<detail::lookup_key<Key>::value,
+                            const basic_any&>::type
+    operator[](const Key& key) const;
+
+    template <typename Key>
+    typename std::enable_if<detail::lookup_key<Key>::value,
+                            typename object::const_iterator>::type
+    find(const Key& key) const;
+
     std::size_t erase(const string_type& key);
 
     typename object::const_iterator erase(typename object::const_iterator it);
@@ -179,8 +366,18 @@ public:
     object_range<object_value_iterator> values() const;
     object_range<object_item_iterator> items() const;
 
+    // A hash of the value's contents, so equal values have equal hashes. An
+    // array's hash depends on the order of its elements and an object's
+    // doesn't depend on the order of its members. Strings, arrays and objects
+    // keep their hash once it's worked out, until they are next changed.
+    // Arrays and objects that mutable references into were taken from, and
+    // those containing them, never keep one, as they can change unseen.
+    std::size_t hash() const;
+
     //
-    // Deep comparisons.
+    // Deep comparisons. Values that share a string, array or object are
+    // equal without looking at it, and ones whose kept hashes differ are
+    // unequal. The ordering can't use hashes, which only tell values apart.
     //
     bool operator==(const basic_any& right) const;
     bool operator!=(const basic_any& right) const;
@@ -197,42 +394,186 @@ public:
     void dump(std::string& str, bool sort_keys = false,
               std::size_t indent = 0) const;
 
+    // Write with an existing writer, e.g. one configured for raw UTF-8.
+    template <typename Stream, std::size_t InlineDepth>
+    void dump(writer<Stream, InlineDepth>& writer,
+              bool sort_keys = false) const;
+
+    // Same output as dump, but the elements of the first large array or
+    // object are split between threads (0 for one per core) and written
+    // into separate buffers.
+    string_type dump_parallel(bool sort_keys = false, std::size_t indent = 0,
+                              unsigned threads = 0) const;
+    void dump_parallel(std::string& str, bool sort_keys = false,
+                       std::size_t indent = 0, unsigned threads = 0) const;
+
+    // Write MessagePack. Container sizes are known, so nothing is buffered.
+    template <typename Stream>
+    void dump(msgpack::writer<Stream>& writer, bool sort_keys = false) const;
+
+    // Write CBOR, with definite lengths.
+    template <typename Stream>
+    void dump(cbor::writer<Stream>& writer, bool sort_keys = false) const;
+
+    // RFC 8785 canonical JSON, for hashing and signing. Write it with a
+    // canonical_writer over a hash_stream to hash it without keeping it.
+    template <typename Stream>
+    void dump(canonical_writer<Stream>& writer) const;
+    string_type dump_canonical() const;
+
 private:
     template <typename Writer>
     void _dump(Writer& writer, bool sort_keys) const;
+    template <typename Stream>
+    void _dump_canonical(canonical_writer<Stream>& writer) const;
+
+    template <typename Stream>
+    void _dump_parallel(Stream& ostr, bool sort_keys, std::size_t indent,
+                        unsigned threads) const;
+    template <typename Writer, typename Stream>
+    void _dump_parallel(Writer& writer, Stream& ostr, bool sort_keys,
+                        std::size_t indent, std::size_t depth,
+                        unsigned threads) const;
 
     void _throw_invalid_type() const;
 
+    long long _int_value() const;
+    double _double_value() const;
+
+    using sorted_items = std::vector<const typename object::value_type*>;
+
+    // An object's items, and once it has been dumped with sort_keys, the same
+    // items in key order. The order is kept until a key is added or erased, so
+    // dumping an unchanged object again doesn't sort it.
+    struct object_data
+    {
+        object_data() = default;
+        object_data(const object& value);
+        object_data(object&& value);
+        object_data(const object_data& right);
+        object_data(object_data&& right);
+        ~object_data();
+
+        object_data& operator=(const object_data&) = delete;
+
+        // Safe to call from several threads at once.
+        const sorted_items& sorted() const;
+
+        void invalidate();
+
+        object items;
+
+    private:
+        mutable std::atomic<const sorted_items*> _sorted{nullptr};
+    };
+
+    // A number's text, and once it has been read, its value. Safe to read
+    // from several threads at once.
+    struct number_data
+    {
+        explicit number_data(string_type value);
+        number_data(const number_data& right);
+
+        long long int_value() const;
+        double double_value() const;
+
+        string_type text;
+        bool real; // has a fraction or an exponent, or is too large
+
+    private:
+        void _convert() const;
+
+        mutable std::atomic<bool> _converted{false};
+        mutable std::atomic<long long> _int{0};
+        mutable std::atomic<double> _double{0.0};
+    };
+
+    // Strings, arrays and objects are kept out of line, along with the
+    // allocator that made them, so a value is only its type and eight bytes.
+    // A node is freed when the last value sharing it is.
+    template <typename T>
+    struct node : rebind_alloc<node<T>>
+    {
+        template <typename... Args>
+        explicit node(const rebind_alloc<node>& allocator, Args&&... args);
+
+        T value;
+        mutable std::atomic<std::size_t> shared_count{1};
+        mutable std::atomic<std::size_t> hash{0}; // 0 until worked out
+
+        // A mutable reference into value was handed out, so it can change
+        // without the node knowing. Set only while the node isn't shared,
+        // and then it never is again.
+        bool leaked = false;
+    };
+
+    template <typename T, typename... Args>
+    static node<T>* _make(Args&&... args);
+    template <typename T>
+    static void _free(node<T>* pointer) noexcept;
+    template <typename T>
+    static void _release(node<T>* pointer) noexcept;
+
+    // The array or object, copied first if it's shared. Its kept hash is
+    // dropped.
+    array& _mutable_array();
+    object_data& _mutable_object();
+
+    // Same, for handing out a mutable reference into it, so its node is
+    // marked leaked.
+    array& _leaked_array();
+    object_data& _leaked_object();
+
+    // True if this is an array or object whose node is leaked. A node that
+    // a leaked one is moved into is marked leaked too, so a hash is never
+    // kept above a node that can change unseen.
+    bool _leaked() const;
+
+    // A new node whose elements share right's.
+    static node<array>* _share_elements(const array& right);
+    static node<object_data>* _share_elements(const object_data& right);
+
+    template <typename T, typename Function>
+    static std::size_t _node_hash(const node<T>* pointer, Function compute);
+
+    // True if both nodes have kept hashes and they differ.
+    template <typename T>
+    static bool _hashes_differ(const node<T>* left, const node<T>* right);
+
     element_type _type;
+    bool _raw = false; // a number kept as a number_data
     union data
     {
         data(std::nullptr_t);
         data(bool value);
         data(long long value);
-        data(long double value);
-        data(const string_type& value);
-        data(const array& value);
-        data(array&& value);
-        data(const object& value);
-        data(object&& value);
-        data(element_type type, const data& right);
-        data(element_type type, data&& right);
-        ~data();
-
-        void assign(element_type, const data& right);
-        void assign(element_type, data&& right);
+        data(double value);
+        data(node<string_type>* value);
+        data(node<array>* value);
+        data(node<object_data>* value);
+        data(element_type type, bool raw, const data& right);
+
+        string_type& as_string() { return _string->value; }
+        const string_type& as_string() const { return _string->value; }
+        array& as_array() { return _array->value; }
+        const array& as_array() const { return _array->value; }
+        object_data& as_object() { return _object->value; }
+        const object_data& as_object() const { return _object->value; }
+        const number_data& as_number() const { return _number->value; }
 
         std::nullptr_t _null;
         bool _bool;
         long long _int;
-        long double _double;
-        string_type _string;
-        array _array;
-        object _object;
+        double _double;
+        node<string_type>* _string;
+        node<array>* _array;
+        node<object_data>* _object;
+        node<number_data>* _number;
     } _data;
 };
 
 using any = basic_any<istring>;
+using ordered_any = basic_any<istring, std::allocator<char>, ordered_objects>;
 
 // Initialize by parsing JSON from the given source.
 template <typename any_type = any, typename IStream>
@@ -252,4 +593,19 @@ any parse(const Ch (&str)[Size]);
 
 #include "native/json/detail/any_impl.h"
 
+namespace std
+{
+
+template <typename String, typename Allocator, typename Objects>
+struct hash<native::json::basic_any<String, Allocator, Objects>>
+{
+    std::size_t operator()(
+        const native::json::basic_any<String, Allocator, Objects>& value) const
+    {
+        return value.hash();
+    }
+};
+
+} // namespace std
+
 #endif
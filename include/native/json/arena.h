@@ -0,0 +1,277 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_ARENA_H__
+#define NATIVE_JSON_ARENA_H__
+
+#include "native/config.h"
+
+#include "native/istring.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace native
+{
+namespace json
+{
+
+// A monotonic arena. Memory is handed out from blocks, each twice the size
+// of the last, and nothing is freed until the arena is released or
+// destroyed.
+class arena
+{
+public:
+    static constexpr std::size_t default_block_size = 64 * 1024;
+    static constexpr std::size_t max_block_size = 16 * 1024 * 1024;
+
+    explicit arena(std::size_t block_size = default_block_size);
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    // alignment must be a power of two.
+    void* allocate(std::size_t size,
+                   std::size_t alignment = alignof(std::max_align_t));
+
+    // Copies length characters and a null character into the arena.
+    template <typename Ch>
+    const Ch* copy(const Ch* s, std::size_t length);
+
+    // Frees every block. Nothing allocated from the arena may be used after.
+    void release();
+
+    // Bytes handed out, and blocks taken from the heap to hold them.
+    std::size_t size() const { return _size; }
+    std::size_t blocks() const { return _blocks; }
+
+    // The arena that default constructed arena_allocators use on this
+    // thread, or null for the heap.
+    static arena* current() { return _current(); }
+
+    // Makes an arena current on this thread until the scope ends.
+    class scope
+    {
+    public:
+        explicit scope(arena& owner)
+            : _previous(_current())
+        {
+            _current() = &owner;
+        }
+        ~scope() { _current() = _previous; }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        arena* _previous;
+    };
+
+private:
+    struct block
+    {
+        block* next;
+        std::size_t size;
+    };
+
+    static arena*& _current()
+    {
+        static thread_local arena* value = nullptr;
+        return value;
+    }
+
+    void _grow(std::size_t size);
+
+    std::size_t _block_size;
+    block* _head = nullptr;
+    std::uintptr_t _position = 0;
+    std::uintptr_t _end = 0;
+    std::size_t _size = 0;
+    std::size_t _blocks = 0;
+};
+
+// An allocator for containers that live in an arena. A default constructed
+// one uses arena::current(), and with no arena it uses the heap. Containers
+// keep the arena they were made with, and copies of them share it.
+template <typename T>
+class arena_allocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    arena_allocator() noexcept
+        : _arena(arena::current())
+    {
+    }
+
+    explicit arena_allocator(arena* owner) noexcept
+        : _arena(owner)
+    {
+    }
+
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& right) noexcept
+        : _arena(right.owner())
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (_arena)
+        {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        if (!_arena)
+        {
+            ::operator delete(p);
+        }
+    }
+
+    arena* owner() const noexcept { return _arena; }
+
+private:
+    arena* _arena;
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T>& left, const arena_allocator<U>& right)
+{
+    return left.owner() == right.owner();
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T>& left, const arena_allocator<U>& right)
+{
+    return left.owner() != right.owner();
+}
+
+namespace detail
+{
+
+// How basic_any::handler makes the strings it is given. For a basic_any in
+// an arena, istring characters are copied into the current arena too.
+template <typename String, typename Allocator>
+struct string_factory
+{
+    template <typename Ch>
+    static String make(const Ch* s, std::size_t length)
+    {
+        return String{s, length};
+    }
+};
+
+template <typename Ch, typename T>
+struct string_factory<basic_istring<Ch>, arena_allocator<T>>
+{
+    static basic_istring<Ch> make(const Ch* s, std::size_t length)
+    {
+        auto* owner = arena::current();
+        if (!owner)
+        {
+            return basic_istring<Ch>{s, length};
+        }
+        return basic_istring<Ch>::external(owner->copy(s, length), length);
+    }
+};
+
+} // namespace detail
+
+//
+// implementation
+//
+
+inline arena::arena(std::size_t block_size)
+    : _block_size(std::max(block_size, sizeof(block) * 2))
+{
+}
+
+inline arena::~arena()
+{
+    release();
+}
+
+inline void* arena::allocate(std::size_t size, std::size_t alignment)
+{
+    auto aligned = (_position + alignment - 1) & ~(alignment - 1);
+    if (!_head || aligned > _end || size > _end - aligned)
+    {
+        _grow(size + alignment);
+        aligned = (_position + alignment - 1) & ~(alignment - 1);
+    }
+
+    _position = aligned + size;
+    _size += size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+template <typename Ch>
+const Ch* arena::copy(const Ch* s, std::size_t length)
+{
+    auto* result =
+        static_cast<Ch*>(allocate((length + 1) * sizeof(Ch), alignof(Ch)));
+    std::memcpy(result, s, length * sizeof(Ch));
+    result[length] = Ch{};
+    return result;
+}
+
+inline void arena::release()
+{
+    while (_head)
+    {
+        auto* next = _head->next;
+        ::operator delete(_head);
+        _head = next;
+    }
+    _position = 0;
+    _end = 0;
+    _size = 0;
+    _blocks = 0;
+}
+
+inline void arena::_grow(std::size_t size)
+{
+    auto capacity = _head ? _head->size * 2 : _block_size;
+    if (capacity > max_block_size)
+    {
+        capacity = max_block_size;
+    }
+    capacity = std::max(capacity, size + sizeof(block));
+
+    auto* next = static_cast<block*>(::operator new(capacity));
+    next->next = _head;
+    next->size = capacity;
+    _head = next;
+    _position = reinterpret_cast<std::uintptr_t>(next + 1);
+    _end = reinterpret_cast<std::uintptr_t>(next) + capacity;
+    ++_blocks;
+}
+
+} // namespace json
+} // namespace native
+
+#endif
@@ -0,0 +1,254 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_ASYNC_STREAM_H__
+#define NATIVE_JSON_ASYNC_STREAM_H__
+
+#include "native/config.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace native
+{
+namespace json
+{
+
+// Double-buffered output stream. The writer fills one buffer while a
+// background thread writes the other to sink, so the writer only waits on the
+// sink when it gets a full buffer ahead (back-pressure).
+//
+// sink is only used by the background thread until close(). If sink has a
+// flush() method, it is called on every flush(). Errors from the sink are
+// rethrown by the next write, flush() or close().
+template <typename Sink>
+class async_stream
+{
+public:
+    using char_type = char;
+
+    static constexpr std::size_t default_buffer_size = 64 * 1024;
+
+    explicit async_stream(Sink& sink,
+                          std::size_t buffer_size = default_buffer_size)
+        : _sink(sink)
+        , _buffer_size(buffer_size ? buffer_size : 1)
+        , _front(new char_type[_buffer_size])
+        , _back(new char_type[_buffer_size])
+        , _current(_front.get())
+        , _last(_front.get() + _buffer_size)
+        , _thread(&async_stream::_run, this)
+    {
+    }
+
+    async_stream(const async_stream&) = delete;
+    async_stream& operator=(const async_stream&) = delete;
+
+    ~async_stream()
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    inline void put(char_type ch)
+    {
+        if (_current == _last)
+        {
+            _swap(false);
+        }
+        *_current++ = ch;
+    }
+
+    inline void write(const char_type* s, std::size_t length)
+    {
+        while (length)
+        {
+            if (_current == _last)
+            {
+                _swap(false);
+            }
+            const auto size =
+                std::min(length, static_cast<std::size_t>(_last - _current));
+            std::memcpy(_current, s, size);
+            _current += size;
+            s += size;
+            length -= size;
+        }
+    }
+
+    // Waits until everything written so far has reached the sink.
+    void flush()
+    {
+        _swap(true);
+        std::unique_lock<std::mutex> lock{_mutex};
+        _idle.wait(lock, [this]
+                   {
+                       return !_pending;
+                   });
+        _rethrow();
+    }
+
+    // Flushes and stops the background thread. Nothing may be written after.
+    void close()
+    {
+        if (!_thread.joinable())
+        {
+            return;
+        }
+
+        std::exception_ptr error;
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            _closing = true;
+        }
+        _ready.notify_one();
+        _thread.join();
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    // Hand the front buffer to the background thread, waiting for it to
+    // finish with the back buffer first.
+    void _swap(bool flush_sink)
+    {
+        std::unique_lock<std::mutex> lock{_mutex};
+        _idle.wait(lock, [this]
+                   {
+                       return !_pending;
+                   });
+        _rethrow();
+
+        std::swap(_front, _back);
+        _back_size = static_cast<std::size_t>(_current - _back.get());
+        _flush_sink = flush_sink;
+        _pending = true;
+        lock.unlock();
+        _ready.notify_one();
+
+        _current = _front.get();
+        _last = _front.get() + _buffer_size;
+    }
+
+    void _rethrow()
+    {
+        if (_error)
+        {
+            auto error = _error;
+            _error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    template <typename S>
+    static auto _flush(S& sink, int) -> decltype(sink.flush(), void())
+    {
+        sink.flush();
+    }
+
+    template <typename S>
+    static void _flush(S&, long)
+    {
+    }
+
+    void _run()
+    {
+        std::unique_lock<std::mutex> lock{_mutex};
+        for (;;)
+        {
+            _ready.wait(lock, [this]
+                        {
+                            return _pending || _closing;
+                        });
+            if (!_pending)
+            {
+                return;
+            }
+
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                if (_back_size)
+                {
+                    _sink.write(_back.get(), _back_size);
+                }
+                if (_flush_sink)
+                {
+                    _flush(_sink, 0);
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            if (error)
+            {
+                _error = error;
+            }
+            _pending = false;
+            _idle.notify_all();
+        }
+    }
+
+    Sink& _sink;
+    std::size_t _buffer_size;
+    std::unique_ptr<char_type[]> _front;
+    std::unique_ptr<char_type[]> _back;
+    char_type* _current;
+    char_type* _last;
+
+    // shared with the background thread
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::condition_variable _idle;
+    std::size_t _back_size = 0;
+    bool _pending = false;
+    bool _flush_sink = false;
+    bool _closing = false;
+    std::exception_ptr _error;
+
+    std::thread _thread;
+};
+
+} // namespace json
+} // namespace native
+
+#endif
@@ -0,0 +1,495 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_CANONICAL_WRITER_H__
+#define NATIVE_JSON_CANONICAL_WRITER_H__
+
+#include "native/config.h"
+
+#include "native/string_slice.h"
+
+#include "native/detail/real.h"
+
+#include "native/json/detail/inline_stack.h"
+#include "native/json/types.h"
+#include "native/json/writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace native
+{
+namespace json
+{
+namespace detail
+{
+
+// Orders UTF-8 strings by their UTF-16 code units, as RFC 8785 sorts keys.
+// This only differs from byte order when U+E000 to U+FFFF is compared with a
+// character above U+FFFF, which UTF-16 encodes with lower surrogates.
+inline bool utf16_less(const char* left, std::size_t left_size,
+                       const char* right, std::size_t right_size)
+{
+    const auto size = std::min(left_size, right_size);
+    const auto* l = reinterpret_cast<const unsigned char*>(left);
+    const auto* r = reinterpret_cast<const unsigned char*>(right);
+    const auto* mismatch = std::mismatch(l, l + size, r).first;
+    if (mismatch == l + size)
+    {
+        return left_size < right_size;
+    }
+
+    // the strings match up to here, so these are both lead bytes or both
+    // continuations of the same lead byte
+    const auto a = *mismatch;
+    const auto b = r[mismatch - l];
+    if (a >= 0xf0 && (b == 0xee || b == 0xef))
+    {
+        return true;
+    }
+    if (b >= 0xf0 && (a == 0xee || a == 0xef))
+    {
+        return false;
+    }
+    return a < b;
+}
+
+struct utf16_key_less
+{
+    template <typename T>
+    bool operator()(const T* left, const T* right) const
+    {
+        return utf16_less(left->first.data(), left->first.size(),
+                          right->first.data(), right->first.size());
+    }
+};
+
+} // namespace detail
+
+// Writes RFC 8785 (JCS) canonical JSON for hashing and signing: no
+// whitespace, object members sorted by their UTF-16 code units, numbers
+// formatted the way ECMAScript does and strings with only the escapes that
+// are required. Strings must be valid UTF-8, and numbers must be finite;
+// std::runtime_error is thrown otherwise.
+//
+// Members can be added in any order. They are buffered until their object is
+// closed, then written sorted. Keys of an object opened with
+// open_sorted_object() must already be in canonical order, and are written
+// straight through.
+//
+// It is a handler too, so a document can be canonicalized as it is parsed:
+//
+//     json::canonical_writer<json::string_stream<>> writer{ostr};
+//     json::parser{}.parse(text, length, writer);
+template <typename Stream>
+class canonical_writer
+{
+public:
+    using char_type = char;
+
+    explicit canonical_writer(Stream& ostr);
+
+    void open_array();
+    void close_array();
+
+    void open_object();
+    void open_sorted_object();
+    void close_object();
+
+    template <typename T>
+    void key(const T& key);
+    void key(const char_type* key);
+    data_type key(const char_type* key, std::size_t length);
+
+    template <typename T>
+    void append(const T& value);
+    void append(const char_type* value, std::size_t length);
+
+    // Handler interface.
+    data_type start_array();
+    void end_array();
+    void start_object();
+    void end_object();
+    template <typename T>
+    void value(const T& value);
+    void value(const char_type* val, std::size_t length);
+
+private:
+    // Goes to the stream, or the buffer when inside an unsorted object.
+    struct output
+    {
+        inline void put(char_type ch)
+        {
+            if (buffer)
+            {
+                buffer->push_back(ch);
+            }
+            else
+            {
+                ostr.put(ch);
+            }
+        }
+
+        inline void write(const char_type* s, std::size_t length)
+        {
+            if (buffer)
+            {
+                buffer->append(s, length);
+            }
+            else
+            {
+                ostr.write(s, length);
+            }
+        }
+
+        Stream& ostr;
+        std::string* buffer;
+    };
+
+    struct frame
+    {
+        enum t : unsigned char
+        {
+            array,
+            object,
+            sorted_object,
+        } type;
+        bool has_elements;
+        std::size_t buffer_start; // unsorted objects only
+        std::size_t members_start;
+    };
+
+    // A buffered member: the raw key then its value, up to the next member.
+    struct member
+    {
+        std::size_t key;
+        std::size_t key_length;
+        std::size_t value;
+    };
+
+    void _begin_value();
+    void _write_key(const char_type* key, std::size_t length);
+    void _close_unsorted(const frame& current);
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, void>::type
+    _write(T value);
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, void>::type
+    _write(T value);
+    template <typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value, void>::type
+    _write(const T& value);
+    void _write(bool value);
+    void _write_double(double value);
+
+    output _output;
+    writer<output, 1> _scalars; // strings and literals, with no state
+    detail::inline_stack<frame, 32> _frames;
+    std::vector<member> _members;
+    std::string _buffer;
+    std::size_t _unsorted_depth = 0;
+
+    // reused by _close_unsorted; each member with the end of its value
+    std::vector<std::pair<member, std::size_t>> _order;
+    std::string _sorted;
+};
+
+template <typename Stream>
+canonical_writer<Stream>::canonical_writer(Stream& ostr)
+    : _output{ostr, nullptr}
+    , _scalars{_output, 0, utf8_validate}
+{
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::open_array()
+{
+    _begin_value();
+    _output.put('[');
+    _frames.push_back(frame{frame::array, false, 0, 0});
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::close_array()
+{
+    _frames.pop_back();
+    _output.put(']');
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::open_object()
+{
+    _begin_value();
+    _frames.push_back(
+        frame{frame::object, false, _buffer.size(), _members.size()});
+    ++_unsorted_depth;
+    _output.buffer = &_buffer;
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::open_sorted_object()
+{
+    _begin_value();
+    _output.put('{');
+    _frames.push_back(frame{frame::sorted_object, false, 0, 0});
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::close_object()
+{
+    const auto current = _frames.back();
+    _frames.pop_back();
+    if (current.type == frame::sorted_object)
+    {
+        _output.put('}');
+    }
+    else
+    {
+        _close_unsorted(current);
+    }
+}
+
+template <typename Stream>
+template <typename T>
+void canonical_writer<Stream>::key(const T& key)
+{
+    _write_key(key.data(), key.size());
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::key(const char_type* key)
+{
+    _write_key(key, std::strlen(key));
+}
+
+template <typename Stream>
+data_type canonical_writer<Stream>::key(const char_type* key,
+                                       std::size_t length)
+{
+    _write_key(key, length);
+    return type_unknown;
+}
+
+template <typename Stream>
+template <typename T>
+void canonical_writer<Stream>::append(const T& value)
+{
+    _begin_value();
+    _write(value);
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::append(const char_type* value,
+                                      std::size_t length)
+{
+    append(string_slice{value, length});
+}
+
+template <typename Stream>
+data_type canonical_writer<Stream>::start_array()
+{
+    open_array();
+    return type_unknown;
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::end_array()
+{
+    close_array();
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::start_object()
+{
+    open_object();
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::end_object()
+{
+    close_object();
+}
+
+template <typename Stream>
+template <typename T>
+void canonical_writer<Stream>::value(const T& value)
+{
+    append(value);
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::value(const char_type* val, std::size_t length)
+{
+    append(string_slice{val, length});
+}
+
+// Members of unsorted objects are separated when they are sorted, and keys
+// take care of the separators in sorted objects.
+template <typename Stream>
+void canonical_writer<Stream>::_begin_value()
+{
+    if (_frames.empty())
+    {
+        return;
+    }
+
+    auto& current = _frames.back();
+    if (current.type == frame::array && current.has_elements)
+    {
+        _output.put(',');
+    }
+    current.has_elements = true;
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::_write_key(const char_type* key,
+                                          std::size_t length)
+{
+    auto& current = _frames.back();
+    if (current.type == frame::sorted_object)
+    {
+        if (current.has_elements)
+        {
+            _output.put(',');
+        }
+        _scalars.append(string_slice{key, length});
+        _output.put(':');
+        return;
+    }
+
+    // the raw key is kept for sorting and encoded later
+    _members.push_back(member{_buffer.size(), length, _buffer.size() + length});
+    _buffer.append(key, length);
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::_close_unsorted(const frame& current)
+{
+    const auto first = _members.begin() + current.members_start;
+    const auto last = _members.end();
+
+    // values run up to the next member's key, so note where each one ends
+    // before they are reordered
+    auto& members = _order;
+    members.clear();
+    for (auto it = first; it != last; ++it)
+    {
+        const auto end = it + 1 == last ? _buffer.size() : (it + 1)->key;
+        members.emplace_back(*it, end);
+    }
+
+    const auto* data = _buffer.data();
+    std::stable_sort(members.begin(), members.end(),
+                     [data](const std::pair<member, std::size_t>& left,
+                            const std::pair<member, std::size_t>& right)
+                     {
+                         return detail::utf16_less(
+                             data + left.first.key, left.first.key_length,
+                             data + right.first.key, right.first.key_length);
+                     });
+
+    // assemble the object separately since it may replace its own buffer
+    --_unsorted_depth;
+    std::string sorted;
+    sorted.swap(_sorted);
+    sorted.clear();
+    _output.buffer = &sorted;
+    _output.put('{');
+    for (std::size_t i = 0; i < members.size(); ++i)
+    {
+        if (i)
+        {
+            _output.put(',');
+        }
+        const auto& item = members[i].first;
+        _scalars.append(string_slice{data + item.key, item.key_length});
+        _output.put(':');
+        _output.write(data + item.value, members[i].second - item.value);
+    }
+    _output.put('}');
+
+    _members.erase(first, last);
+    _buffer.resize(current.buffer_start);
+    _output.buffer = _unsorted_depth ? &_buffer : nullptr;
+    _output.write(sorted.data(), sorted.size());
+    sorted.swap(_sorted);
+}
+
+// Integers are written as they are when a double can hold them exactly,
+// otherwise they are written as the double they would be read back as.
+template <typename Stream>
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, void>::type
+canonical_writer<Stream>::_write(T value)
+{
+    const T limit = static_cast<T>(std::min<unsigned long long>(
+        1ULL << 53, std::numeric_limits<T>::max()));
+    if (value > limit || (std::is_signed<T>::value && value < -limit))
+    {
+        _write_double(static_cast<double>(value));
+        return;
+    }
+    ::native::detail::stream_append(_output, value);
+}
+
+template <typename Stream>
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, void>::type
+canonical_writer<Stream>::_write(T value)
+{
+    _write_double(static_cast<double>(value));
+}
+
+template <typename Stream>
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, void>::type
+canonical_writer<Stream>::_write(const T& value)
+{
+    _scalars.append(value);
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::_write(bool value)
+{
+    _scalars.append(value);
+}
+
+template <typename Stream>
+void canonical_writer<Stream>::_write_double(double value)
+{
+    if (!std::isfinite(value))
+    {
+        throw std::runtime_error("canonical json can't hold nan or infinity");
+    }
+
+    using double_conversion::DoubleToStringConverter;
+    char buffer[32];
+    double_conversion::StringBuilder builder{buffer, sizeof(buffer)};
+    DoubleToStringConverter::EcmaScriptConverter().ToShortest(value, &builder);
+    _output.write(buffer, builder.position());
+}
+
+} // namespace json
+} // namespace native
+
+#endif
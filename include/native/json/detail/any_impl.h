@@ -14,23 +14,124 @@
 // limitations under the License.
 //
 
+#include "native/json/output_streams.h"
 #include "native/json/writer.h"
 #include "native/json/parser.h"
 #include "native/string_builder.h"
 #include "native/detail/stream_type.h"
 
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <thread>
+
 namespace native
 {
 namespace json
 {
+namespace detail
+{
+
+// Writers that need container sizes up front, like msgpack::writer, are given
+// them.
+template <typename Writer>
+auto open_array(Writer& writer, std::size_t size, int)
+    -> decltype(writer.open_array(size), void())
+{
+    writer.open_array(size);
+}
+
+template <typename Writer>
+void open_array(Writer& writer, std::size_t, long)
+{
+    writer.open_array();
+}
+
+template <typename Writer>
+auto open_object(Writer& writer, std::size_t size, int)
+    -> decltype(writer.open_object(size), void())
+{
+    writer.open_object(size);
+}
+
+template <typename Writer>
+void open_object(Writer& writer, std::size_t, long)
+{
+    writer.open_object();
+}
+
+// JSON writers are given a lazily converted number's text as it is. Others
+// are given its value.
+template <typename Writer, typename Number>
+auto append_number(Writer& writer, const Number& number, int)
+    -> decltype(writer.append_number(number.text.data(), number.text.size()),
+                void())
+{
+    writer.append_number(number.text.data(), number.text.size());
+}
+
+template <typename Writer, typename Number>
+void append_number(Writer& writer, const Number& number, long)
+{
+    if (number.real)
+    {
+        writer.append(number.double_value());
+    }
+    else
+    {
+        writer.append(number.int_value());
+    }
+}
 
+// Whether an integer's text fits in a long long, or in an unsigned long long
+// that wraps into one, as the parser's values do.
 template <typename String>
-struct basic_any<String>::object_key_iterator
+bool integer_fits(const String& text)
+{
+    const std::size_t sign = !text.empty() && text[0] == '-' ? 1 : 0;
+    const char* const max =
+        sign ? "9223372036854775808" : "18446744073709551615";
+    const auto max_digits = std::strlen(max);
+    const auto digits = text.size() - sign;
+    if (digits != max_digits)
+    {
+        return digits < max_digits;
+    }
+    return !std::lexicographical_compare(max, max + max_digits,
+                                         text.begin() + sign, text.end());
+}
+
+// Out of range values saturate instead of being undefined.
+inline long long saturate_integer(double value)
+{
+    if (value >= 9223372036854775807.0)
+    {
+        return std::numeric_limits<long long>::max();
+    }
+    if (value <= -9223372036854775808.0)
+    {
+        return std::numeric_limits<long long>::min();
+    }
+    return value == value ? static_cast<long long>(value) : 0;
+}
+
+// Mixes value into seed, for hashes of sequences.
+inline std::size_t hash_combine(std::size_t seed, std::size_t value)
+{
+    return seed ^ (value + static_cast<std::size_t>(0x9e3779b97f4a7c15ULL) +
+                   (seed << 6) + (seed >> 2));
+}
+
+} // namespace detail
+
+template <typename String, typename Allocator, typename Objects>
+struct basic_any<String, Allocator, Objects>::object_key_iterator
 {
     using value_type = String;
 
     object_key_iterator(
-        typename basic_any<String>::object::const_iterator element)
+        typename basic_any::object::const_iterator element)
         : _element{element}
     {
     }
@@ -62,16 +163,16 @@ struct basic_any<String>::object_key_iterator
     }
 
 private:
-    typename basic_any<String>::object::const_iterator _element;
+    typename basic_any::object::const_iterator _element;
 };
 
-template <typename String>
-struct basic_any<String>::object_value_iterator
+template <typename String, typename Allocator, typename Objects>
+struct basic_any<String, Allocator, Objects>::object_value_iterator
 {
     using value_type = basic_any;
 
     object_value_iterator(
-        typename basic_any<String>::object::const_iterator element)
+        typename basic_any::object::const_iterator element)
         : _element{element}
     {
     }
@@ -103,16 +204,16 @@ struct basic_any<String>::object_value_iterator
     }
 
 private:
-    typename basic_any<String>::object::const_iterator _element;
+    typename basic_any::object::const_iterator _element;
 };
 
-template <typename String>
-struct basic_any<String>::object_item_iterator
+template <typename String, typename Allocator, typename Objects>
+struct basic_any<String, Allocator, Objects>::object_item_iterator
 {
-    using value_type = typename basic_any<String>::object::value_type;
+    using value_type = typename basic_any::object::value_type;
 
     object_item_iterator(
-        typename basic_any<String>::object::const_iterator element)
+        typename basic_any::object::const_iterator element)
         : _element{element}
     {
     }
@@ -144,17 +245,17 @@ struct basic_any<String>::object_item_iterator
     }
 
 private:
-    typename basic_any<String>::object::const_iterator _element;
+    typename basic_any::object::const_iterator _element;
 };
 
-template <typename String>
+template <typename String, typename Allocator, typename Objects>
 template <typename Iterator>
-struct basic_any<String>::object_range
+struct basic_any<String, Allocator, Objects>::object_range
 {
     using const_iterator = Iterator;
     using value_type = typename Iterator::value_type;
 
-    object_range(const basic_any<String>::object* object = nullptr)
+    object_range(const basic_any::object* object = nullptr)
         : _object(object)
     {
     }
@@ -164,116 +265,403 @@ struct basic_any<String>::object_range
     Iterator end() const { return _object->end(); }
 
 private:
-    const basic_any<String>::object* _object;
+    const basic_any::object* _object;
 };
 
-template <typename String>
-inline basic_any<String>::data::data(std::nullptr_t)
-    : _null{nullptr}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::object_data::object_data(
+    const object& value)
+    : items{value}
 {
 }
 
-template <typename String>
-inline basic_any<String>::data::data(bool value)
-    : _bool{value}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::object_data::object_data(
+    object&& value)
+    : items{std::move(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::data::data(long long value)
-    : _int{value}
+// The sorted order points into right's items, so it isn't copied.
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::object_data::object_data(
+    const object_data& right)
+    : items{right.items}
 {
 }
 
-template <typename String>
-inline basic_any<String>::data::data(long double value)
-    : _double{value}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::object_data::object_data(
+    object_data&& right)
+    : items{std::move(right.items)}
 {
+    right.invalidate();
 }
 
-template <typename String>
-inline basic_any<String>::data::data(const String& value)
-    : _string{value}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::object_data::~object_data()
 {
+    delete _sorted.load(std::memory_order_relaxed);
 }
 
-template <typename String>
-inline basic_any<String>::data::data(const array& value)
-    : _array{value}
+// Readers race to build the order; the first one published wins and the rest
+// are discarded.
+template <typename String, typename Allocator, typename Objects>
+const typename basic_any<String, Allocator, Objects>::sorted_items&
+basic_any<String, Allocator, Objects>::object_data::sorted() const
+{
+    const auto* result = _sorted.load(std::memory_order_acquire);
+    if (result)
+    {
+        return *result;
+    }
+
+    std::unique_ptr<sorted_items> order{new sorted_items};
+    order->reserve(items.size());
+    for (const auto& element : items)
+    {
+        order->push_back(&element);
+    }
+    std::sort(order->begin(), order->end(),
+              [](const typename object::value_type* left,
+                 const typename object::value_type* right)
+              {
+                  return left->first < right->first;
+              });
+
+    if (_sorted.compare_exchange_strong(result, order.get(),
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire))
+    {
+        result = order.release();
+    }
+    return *result;
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline void basic_any<String, Allocator, Objects>::object_data::invalidate()
 {
+    delete _sorted.exchange(nullptr, std::memory_order_acq_rel);
 }
 
-template <typename String>
-inline basic_any<String>::data::data(array&& value)
-    : _array{}
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::number_data::number_data(
+    string_type value)
+    : text{std::move(value)}
+    , real{std::any_of(text.begin(), text.end(), [](char ch)
+                       {
+                           return ch == '.' || ch == 'e' || ch == 'E';
+                       }) ||
+           !detail::integer_fits(text)}
 {
-    _array.reserve(value.size());
-    for (auto& element : value)
+}
+
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::number_data::number_data(
+    const number_data& right)
+    : text{right.text}
+    , real{right.real}
+{
+    if (right._converted.load(std::memory_order_acquire))
     {
-        _array.emplace_back(std::move(element));
+        _int.store(right._int.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+        _double.store(right._double.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+        _converted.store(true, std::memory_order_relaxed);
     }
 }
 
-template <typename String>
-inline basic_any<String>::data::data(const object& value)
-    : _object{value}
+template <typename String, typename Allocator, typename Objects>
+inline long long
+basic_any<String, Allocator, Objects>::number_data::int_value() const
 {
+    _convert();
+    return _int.load(std::memory_order_relaxed);
 }
 
-template <typename String>
-inline basic_any<String>::data::data(object&& value)
-    : _object{std::move(value)}
+template <typename String, typename Allocator, typename Objects>
+inline double
+basic_any<String, Allocator, Objects>::number_data::double_value() const
 {
+    _convert();
+    return _double.load(std::memory_order_relaxed);
 }
 
-template <typename String>
-inline basic_any<String>::data::data(element_type type,
-                                     const basic_any<String>::data& right)
+// Both values are kept, converted the way the parser would have converted
+// the number and the way basic_any converts it from there. Integers too large
+// for the parser are reals. Readers that race store the same values.
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::number_data::_convert() const
 {
-    assign(type, right);
+    if (_converted.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    if (real)
+    {
+        const auto value = to<double>(text);
+        _double.store(value, std::memory_order_relaxed);
+        _int.store(detail::saturate_integer(value),
+                   std::memory_order_relaxed);
+    }
+    else
+    {
+        // large positive integers wrap, as basic_any(unsigned long long) does
+        const auto value =
+            text[0] == '-'
+                ? to<long long>(text)
+                : static_cast<long long>(to<unsigned long long>(text));
+        _int.store(value, std::memory_order_relaxed);
+        _double.store(static_cast<double>(value), std::memory_order_relaxed);
+    }
+    _converted.store(true, std::memory_order_release);
 }
 
-template <typename String>
-inline basic_any<String>::data::data(element_type type,
-                                     basic_any<String>::data&& right)
+template <typename String, typename Allocator, typename Objects>
+template <typename T>
+template <typename... Args>
+basic_any<String, Allocator, Objects>::node<T>::node(
+    const rebind_alloc<node>& allocator, Args&&... args)
+    : rebind_alloc<node>(allocator)
+    , value(std::forward<Args>(args)...)
 {
-    assign(type, std::move(right));
 }
 
-template <typename String>
-void basic_any<String>::data::assign(element_type type,
-                                     const basic_any<String>::data& right)
+template <typename String, typename Allocator, typename Objects>
+template <typename T, typename... Args>
+typename basic_any<String, Allocator, Objects>::template node<T>*
+basic_any<String, Allocator, Objects>::_make(Args&&... args)
 {
-    switch (type)
+    rebind_alloc<node<T>> allocator;
+    auto* pointer = allocator.allocate(1);
+    try
     {
-        case json_null:
-            _null = nullptr;
-            break;
-        case json_bool:
-            _bool = right._bool;
-            break;
-        case json_integer:
-            _int = right._int;
-            break;
-        case json_real:
-            _double = right._double;
-            break;
-        case json_string:
-            new (&_string) string_type{right._string};
-            break;
-        case json_array:
-            new (&_array) array;
-            _array.assign(right._array.begin(), right._array.end());
-            break;
-        case json_object:
-            new (&_object) object{right._object};
-            break;
+        return new (pointer) node<T>(allocator, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        allocator.deallocate(pointer, 1);
+        throw;
     }
 }
 
-template <typename String>
-void basic_any<String>::data::assign(element_type type,
-                                     basic_any<String>::data&& right)
+template <typename String, typename Allocator, typename Objects>
+template <typename T>
+void basic_any<String, Allocator, Objects>::_free(node<T>* pointer) noexcept
+{
+    rebind_alloc<node<T>> allocator{*pointer};
+    pointer->~node<T>();
+    allocator.deallocate(pointer, 1);
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename T>
+void basic_any<String, Allocator, Objects>::_release(node<T>* pointer) noexcept
+{
+    if (pointer->shared_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        _free(pointer);
+    }
+}
+
+// A copy of a shared array or object shares its elements, so changing one
+// element only copies the path down to it. When the count is one, no other
+// value can be sharing the node, so there is nothing to race with.
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::array&
+basic_any<String, Allocator, Objects>::_mutable_array()
+{
+    if (_data._array->shared_count.load(std::memory_order_acquire) != 1)
+    {
+        auto* copy = _share_elements(_data.as_array());
+        _release(_data._array);
+        _data._array = copy;
+    }
+    else
+    {
+        _data._array->hash.store(0, std::memory_order_relaxed);
+    }
+    return _data.as_array();
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::object_data&
+basic_any<String, Allocator, Objects>::_mutable_object()
+{
+    if (_data._object->shared_count.load(std::memory_order_acquire) != 1)
+    {
+        auto* copy = _share_elements(_data.as_object());
+        _release(_data._object);
+        _data._object = copy;
+    }
+    else
+    {
+        _data._object->hash.store(0, std::memory_order_relaxed);
+    }
+    return _data.as_object();
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::array&
+basic_any<String, Allocator, Objects>::_leaked_array()
+{
+    auto& result = _mutable_array();
+    _data._array->leaked = true;
+    return result;
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::object_data&
+basic_any<String, Allocator, Objects>::_leaked_object()
+{
+    auto& result = _mutable_object();
+    _data._object->leaked = true;
+    return result;
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::_leaked() const
+{
+    return (_type == json_array && _data._array->leaked) ||
+           (_type == json_object && _data._object->leaked);
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::template node<
+    typename basic_any<String, Allocator, Objects>::array>*
+basic_any<String, Allocator, Objects>::_share_elements(const array& right)
+{
+    auto* copy = _make<array>();
+    try
+    {
+        copy->value.reserve(right.size());
+        for (const auto& element : right)
+        {
+            copy->value.push_back(element.share());
+        }
+    }
+    catch (...)
+    {
+        _free(copy);
+        throw;
+    }
+    return copy;
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::template node<
+    typename basic_any<String, Allocator, Objects>::object_data>*
+basic_any<String, Allocator, Objects>::_share_elements(
+    const object_data& right)
+{
+    auto* copy = _make<object_data>();
+    try
+    {
+        copy->value.items.reserve(right.items.size());
+        for (const auto& element : right.items)
+        {
+            copy->value.items.emplace(element.first, element.second.share());
+        }
+    }
+    catch (...)
+    {
+        _free(copy);
+        throw;
+    }
+    return copy;
+}
+
+// A leaked node's hash is worked out every time, as what it holds can
+// change without it knowing.
+template <typename String, typename Allocator, typename Objects>
+template <typename T, typename Function>
+std::size_t
+basic_any<String, Allocator, Objects>::_node_hash(const node<T>* pointer,
+                                                  Function compute)
+{
+    if (pointer->leaked)
+    {
+        return compute();
+    }
+
+    auto result = pointer->hash.load(std::memory_order_relaxed);
+    if (result == 0)
+    {
+        result = compute();
+        if (result == 0)
+        {
+            result = 1;
+        }
+        pointer->hash.store(result, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename T>
+inline bool
+basic_any<String, Allocator, Objects>::_hashes_differ(const node<T>* left,
+                                                      const node<T>* right)
+{
+    if (left->leaked || right->leaked)
+    {
+        return false;
+    }
+    const auto left_hash = left->hash.load(std::memory_order_relaxed);
+    const auto right_hash = right->hash.load(std::memory_order_relaxed);
+    return left_hash != 0 && right_hash != 0 && left_hash != right_hash;
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(std::nullptr_t)
+    : _null{nullptr}
+{
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(bool value)
+    : _bool{value}
+{
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(long long value)
+    : _int{value}
+{
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(double value)
+    : _double{value}
+{
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(
+    node<string_type>* value)
+    : _string{value}
+{
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(node<array>* value)
+    : _array{value}
+{
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::data::data(
+    node<object_data>* value)
+    : _object{value}
+{
+}
+
+// A deep copy.
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::data::data(
+    element_type type, bool raw, const basic_any::data& right)
 {
     switch (type)
     {
@@ -284,41 +672,51 @@ void basic_any<String>::data::assign(element_type type,
             _bool = right._bool;
             break;
         case json_integer:
-            _int = right._int;
-            break;
         case json_real:
-            _double = right._double;
+            if (raw)
+            {
+                _number = _make<number_data>(right.as_number());
+            }
+            else if (type == json_integer)
+            {
+                _int = right._int;
+            }
+            else
+            {
+                _double = right._double;
+            }
             break;
         case json_string:
-            new (&_string) string_type{right._string};
+            _string = _make<string_type>(right.as_string());
             break;
         case json_array:
-            new (&_array) array;
-            _array.reserve(right._array.size());
-            for (auto& element : right._array)
+            _array = _make<array>();
+            try
+            {
+                as_array().assign(right.as_array().begin(),
+                                  right.as_array().end());
+            }
+            catch (...)
             {
-                _array.emplace_back(std::move(element));
+                _free(_array);
+                throw;
             }
             break;
         case json_object:
-            new (&_object) object{std::move(right._object)};
+            _object = _make<object_data>(right.as_object());
             break;
     }
 }
 
-template <typename String>
-basic_any<String>::data::~data()
-{
-}
-
-template <typename String>
-inline basic_any<String>::basic_any() noexcept : _type{json_null},
-                                                 _data{nullptr}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any() noexcept
+    : _type{json_null}
+    , _data{nullptr}
 {
 }
 
-template <typename String>
-basic_any<String>::basic_any(element_type type)
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::basic_any(element_type type)
     : _type{type}
     , _data{nullptr}
 {
@@ -337,259 +735,332 @@ basic_any<String>::basic_any(element_type type)
             _data._double = 0.0;
             break;
         case json_string:
-            new (&_data._string) string_type;
+            _data._string = _make<string_type>();
             break;
         case json_array:
-            new (&_data._array) array;
+            _data._array = _make<array>();
             break;
         case json_object:
-            new (&_data._object) object;
+            _data._object = _make<object_data>();
             break;
     }
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(std::nullptr_t) noexcept : _type{json_null},
-                                                               _data{nullptr}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(std::nullptr_t) noexcept
+    : _type{json_null}
+    , _data{nullptr}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(bool value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(bool value)
     : _type(json_bool)
     , _data{value}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(short value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(short value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(unsigned short value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(unsigned short value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(int value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(int value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(unsigned value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(unsigned value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(long value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(long value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(unsigned long value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(unsigned long value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(long long value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(long long value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(unsigned long long value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(
+    unsigned long long value)
     : _type(json_integer)
     , _data{static_cast<long long>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(float value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(float value)
     : _type{json_real}
-    , _data{static_cast<long double>(value)}
+    , _data{static_cast<double>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(double value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(double value)
     : _type{json_real}
-    , _data{static_cast<long double>(value)}
+    , _data{static_cast<double>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(long double value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(long double value)
     : _type{json_real}
-    , _data{value}
+    , _data{static_cast<double>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(const char* value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(const char* value)
     : basic_any{string_type{value}}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(const string_type& value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(
+    const string_type& value)
     : _type{json_string}
-    , _data{value}
+    , _data{_make<string_type>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(const array& value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(const array& value)
     : _type{json_array}
-    , _data{value}
+    , _data{_make<array>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(array&& value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(array&& value)
     : _type{json_array}
-    , _data{std::move(value)}
+    , _data{_make<array>()}
 {
+    auto& elements = _data.as_array();
+    elements.reserve(value.size());
+    for (auto& element : value)
+    {
+        _data._array->leaked |= element._leaked();
+        elements.emplace_back(std::move(element));
+    }
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(const object& value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(const object& value)
     : _type{json_object}
-    , _data{value}
+    , _data{_make<object_data>(value)}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(object&& value)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(object&& value)
     : _type{json_object}
-    , _data{std::move(value)}
+    , _data{_make<object_data>(std::move(value))}
 {
+    for (const auto& item : _data.as_object().items)
+    {
+        _data._object->leaked |= item.second._leaked();
+    }
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(const basic_any<String>& right)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(const basic_any& right)
     : _type{right._type}
-    , _data{right._type, right._data}
+    , _raw{right._raw}
+    , _data{right._type, right._raw, right._data}
 {
 }
 
-template <typename String>
-inline basic_any<String>::basic_any(basic_any<String>&& right) noexcept
-    : _type{right._type},
-      _data{right._type, right._data}
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>::basic_any(
+    basic_any&& right) noexcept
+    : _type{right._type}
+    , _raw{right._raw}
+    , _data{right._data}
 {
+    right._type = json_null;
+    right._raw = false;
 }
 
-template <typename String>
-inline basic_any<String>& basic_any<String>::
-operator=(const basic_any<String>& right)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::operator=(const basic_any& right)
 {
-    this->~basic_any();
-    _type = right._type;
-    _data.assign(_type, right._data);
-    return *this;
+    return *this = basic_any{right};
 }
 
-template <typename String>
-inline basic_any<String>& basic_any<String>::
-operator=(basic_any<String>&& right) noexcept
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::operator=(basic_any&& right) noexcept
 {
-    this->~basic_any();
-    _type = right._type;
-    _data.assign(_type, std::move(right._data));
-    return *this;
+    if (this != &right)
+    {
+        this->~basic_any();
+        _type = right._type;
+        _raw = right._raw;
+        _data = right._data;
+        right._type = json_null;
+        right._raw = false;
+    }
+    return *this;
 }
 
-template <typename String>
-basic_any<String>::~basic_any()
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>
+basic_any<String, Allocator, Objects>::share() const
 {
+    basic_any result;
     switch (_type)
     {
         case json_null:
         case json_bool:
+            break;
         case json_integer:
         case json_real:
+            if (_raw)
+            {
+                _data._number->shared_count.fetch_add(
+                    1, std::memory_order_relaxed);
+            }
             break;
         case json_string:
-            _data._string.~string_type();
+            _data._string->shared_count.fetch_add(1, std::memory_order_relaxed);
             break;
         case json_array:
-            _data._array.~array();
+            if (_data._array->leaked)
+            {
+                result._data._array = _share_elements(_data.as_array());
+                result._type = _type;
+                return result;
+            }
+            _data._array->shared_count.fetch_add(1, std::memory_order_relaxed);
             break;
         case json_object:
-            _data._object.~object();
+            if (_data._object->leaked)
+            {
+                result._data._object = _share_elements(_data.as_object());
+                result._type = _type;
+                return result;
+            }
+            _data._object->shared_count.fetch_add(1, std::memory_order_relaxed);
             break;
     }
+    result._type = _type;
+    result._raw = _raw;
+    result._data = _data;
+    return result;
 }
 
-template <typename String>
-inline element_type basic_any<String>::type() const
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::~basic_any()
+{
+    switch (_type)
+    {
+        case json_null:
+        case json_bool:
+            break;
+        case json_integer:
+        case json_real:
+            if (_raw)
+            {
+                _release(_data._number);
+            }
+            break;
+        case json_string:
+            _release(_data._string);
+            break;
+        case json_array:
+            _release(_data._array);
+            break;
+        case json_object:
+            _release(_data._object);
+            break;
+    }
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline element_type basic_any<String, Allocator, Objects>::type() const
 {
     return _type;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_null() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_null() const
 {
     return _type == json_null;
 }
-template <typename String>
-inline bool basic_any<String>::is_object() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_object() const
 {
     return _type == json_object;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_array() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_array() const
 {
     return _type == json_array;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_bool() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_bool() const
 {
     return _type == json_bool;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_double() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_double() const
 {
     return _type == json_real;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_int() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_int() const
 {
     return _type == json_integer;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_string() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_string() const
 {
     return _type == json_string;
 }
 
-template <typename String>
-inline bool basic_any<String>::is_number() const
+template <typename String, typename Allocator, typename Objects>
+inline bool basic_any<String, Allocator, Objects>::is_number() const
 {
     return is_int() || is_double();
 }
 
-template <typename String>
-String basic_any<String>::string_value() const
+template <typename String, typename Allocator, typename Objects>
+String basic_any<String, Allocator, Objects>::string_value() const
 {
     switch (_type)
     {
@@ -600,29 +1071,31 @@ String basic_any<String>::string_value() const
         case json_bool:
             return to<string_type>(_data._bool);
         case json_real:
-            return to<string_type>(_data._double);
+            return _raw ? _data.as_number().text
+                        : to<string_type>(_data._double);
         case json_integer:
-            return to<string_type>(_data._int);
+            return _raw ? _data.as_number().text
+                        : to<string_type>(_data._int);
         case json_string:
-            return _data._string;
+            return _data.as_string();
     }
 }
 
-template <typename String>
-long double basic_any<String>::double_value() const
+template <typename String, typename Allocator, typename Objects>
+long double basic_any<String, Allocator, Objects>::double_value() const
 {
     switch (_type)
     {
         case json_null:
             return 0.0;
         case json_string:
-            return to<long double>(_data._string);
+            return to<long double>(_data.as_string());
         case json_bool:
             return _data._bool;
         case json_real:
-            return _data._double;
+            return _double_value();
         case json_integer:
-            return _data._int;
+            return _int_value();
         case json_array:
         case json_object:
             _throw_invalid_type();
@@ -630,21 +1103,22 @@ long double basic_any<String>::double_value() const
     }
 }
 
-template <typename String>
-long long basic_any<String>::int_value() const
+template <typename String, typename Allocator, typename Objects>
+long long basic_any<String, Allocator, Objects>::int_value() const
 {
     switch (_type)
     {
         case json_null:
             return 0;
         case json_string:
-            return to<long long>(_data._string);
+            return to<long long>(_data.as_string());
         case json_bool:
             return _data._bool;
         case json_real:
-            return to<long long>(_data._double);
+            return _raw ? _data.as_number().int_value()
+                        : to<long long>(_data._double);
         case json_integer:
-            return _data._int;
+            return _int_value();
         case json_array:
         case json_object:
             _throw_invalid_type();
@@ -652,8 +1126,8 @@ long long basic_any<String>::int_value() const
     }
 }
 
-template <typename String>
-bool basic_any<String>::bool_value() const
+template <typename String, typename Allocator, typename Objects>
+bool basic_any<String, Allocator, Objects>::bool_value() const
 {
     switch (_type)
     {
@@ -662,11 +1136,11 @@ bool basic_any<String>::bool_value() const
         case json_bool:
             return _data._bool;
         case json_integer:
-            return to<bool>(_data._int);
+            return to<bool>(_int_value());
         case json_real:
-            return to<bool>(_data._double);
+            return to<bool>(_double_value());
         case json_string:
-            return to<bool>(_data._string);
+            return to<bool>(_data.as_string());
         case json_array:
         case json_object:
             _throw_invalid_type();
@@ -674,8 +1148,8 @@ bool basic_any<String>::bool_value() const
     }
 }
 
-template <typename String>
-bool basic_any<String>::empty() const
+template <typename String, typename Allocator, typename Objects>
+bool basic_any<String, Allocator, Objects>::empty() const
 {
     switch (_type)
     {
@@ -686,16 +1160,16 @@ bool basic_any<String>::empty() const
         case json_real:
             return false;
         case json_string:
-            return _data._string.empty();
+            return _data.as_string().empty();
         case json_array:
-            return _data._array.empty();
+            return _data.as_array().empty();
         case json_object:
-            return _data._object.empty();
+            return _data.as_object().items.empty();
     }
 }
 
-template <typename String>
-std::size_t basic_any<String>::size() const
+template <typename String, typename Allocator, typename Objects>
+std::size_t basic_any<String, Allocator, Objects>::size() const
 {
     switch (_type)
     {
@@ -705,98 +1179,104 @@ std::size_t basic_any<String>::size() const
         case json_real:
             _throw_invalid_type();
         case json_string:
-            return _data._string.size();
+            return _data.as_string().size();
         case json_array:
-            return _data._array.size();
+            return _data.as_array().size();
         case json_object:
-            return _data._object.size();
+            return _data.as_object().items.size();
     }
 }
 
 //
 // array
 //
-template <typename String>
-inline typename basic_any<String>::const_iterator
-basic_any<String>::begin() const
+template <typename String, typename Allocator, typename Objects>
+inline typename basic_any<String, Allocator, Objects>::const_iterator
+basic_any<String, Allocator, Objects>::begin() const
 {
     if (_type != json_array)
     {
         _throw_invalid_type();
     }
-    return _data._array.begin();
+    return _data.as_array().begin();
 }
 
-template <typename String>
-inline typename basic_any<String>::const_iterator basic_any<String>::end() const
+template <typename String, typename Allocator, typename Objects>
+inline typename basic_any<String, Allocator, Objects>::const_iterator
+basic_any<String, Allocator, Objects>::end() const
 {
     if (_type != json_array)
     {
         _throw_invalid_type();
     }
-    return _data._array.end();
+    return _data.as_array().end();
 }
 
-template <typename String>
-basic_any<String>& basic_any<String>::front()
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::front()
 {
     if (_type != json_array)
     {
         _throw_invalid_type();
     }
-    return _data._array.front();
+    return _leaked_array().front();
 }
 
-template <typename String>
-const basic_any<String>& basic_any<String>::front() const
+template <typename String, typename Allocator, typename Objects>
+const basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::front() const
 {
     if (_type != json_array)
     {
         _throw_invalid_type();
     }
-    return _data._array.front();
+    return _data.as_array().front();
 }
 
-template <typename String>
-basic_any<String>& basic_any<String>::back()
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::back()
 {
     if (_type != json_array)
     {
         _throw_invalid_type();
     }
-    return _data._array.back();
+    return _leaked_array().back();
 }
 
-template <typename String>
-const basic_any<String>& basic_any<String>::back() const
+template <typename String, typename Allocator, typename Objects>
+const basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::back() const
 {
     if (_type != json_array)
     {
         _throw_invalid_type();
     }
-    return _data._array.back();
+    return _data.as_array().back();
 }
 
-template <typename String>
-inline basic_any<String>& basic_any<String>::operator[](std::size_t i)
+template <typename String, typename Allocator, typename Objects>
+inline basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::operator[](std::size_t i)
 {
-    return _data._array[i];
+    return _leaked_array()[i];
 }
 
-template <typename String>
-inline const basic_any<String>& basic_any<String>::
-operator[](std::size_t i) const
+template <typename String, typename Allocator, typename Objects>
+inline const basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::operator[](std::size_t i) const
 {
-    return _data._array[i];
+    return _data.as_array()[i];
 }
 
-template <typename String>
-void basic_any<String>::push_back(const basic_any<String>& value)
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::push_back(const basic_any& value)
 {
     switch (_type)
     {
         case json_array:
-            return _data._array.push_back(value);
+            return _mutable_array().push_back(value);
         case json_null:
         case json_bool:
         case json_integer:
@@ -807,13 +1287,18 @@ void basic_any<String>::push_back(const basic_any<String>& value)
     }
 }
 
-template <typename String>
-void basic_any<String>::emplace_back(basic_any<String>&& value)
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::emplace_back(basic_any&& value)
 {
     switch (_type)
     {
         case json_array:
-            return _data._array.emplace_back(std::move(value));
+        {
+            const auto leaked = value._leaked();
+            _mutable_array().emplace_back(std::move(value));
+            _data._array->leaked |= leaked;
+            return;
+        }
         case json_null:
         case json_bool:
         case json_integer:
@@ -824,13 +1309,32 @@ void basic_any<String>::emplace_back(basic_any<String>&& value)
     }
 }
 
-template <typename String>
-void basic_any<String>::pop_back()
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::const_iterator
+basic_any<String, Allocator, Objects>::insert(const_iterator it,
+                                              const basic_any& value)
+{
+    return emplace(it, basic_any{value});
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::const_iterator
+basic_any<String, Allocator, Objects>::emplace(const_iterator it,
+                                               basic_any&& value)
 {
     switch (_type)
     {
         case json_array:
-            return _data._array.pop_back();
+        {
+            // it may be in the array this one shares
+            const auto index = it - _data.as_array().cbegin();
+            const auto leaked = value._leaked();
+            auto& elements = _mutable_array();
+            const auto result =
+                elements.emplace(elements.cbegin() + index, std::move(value));
+            _data._array->leaked |= leaked;
+            return result;
+        }
         case json_null:
         case json_bool:
         case json_integer:
@@ -838,17 +1342,17 @@ void basic_any<String>::pop_back()
         case json_string:
         case json_object:
             _throw_invalid_type();
+            return basic_any::const_iterator{};
     }
 }
 
-template <typename String>
-void basic_any<String>::resize(std::size_t n,
-                               const basic_any<String>& defaultValue)
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::pop_back()
 {
     switch (_type)
     {
         case json_array:
-            return _data._array.resize(n, defaultValue);
+            return _mutable_array().pop_back();
         case json_null:
         case json_bool:
         case json_integer:
@@ -859,14 +1363,14 @@ void basic_any<String>::resize(std::size_t n,
     }
 }
 
-template <typename String>
-typename basic_any<String>::const_iterator
-basic_any<String>::erase(const_iterator it)
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::resize(
+    std::size_t n, const basic_any& defaultValue)
 {
     switch (_type)
     {
         case json_array:
-            return _data._array.erase(it);
+            return _mutable_array().resize(n, defaultValue);
         case json_null:
         case json_bool:
         case json_integer:
@@ -874,18 +1378,50 @@ basic_any<String>::erase(const_iterator it)
         case json_string:
         case json_object:
             _throw_invalid_type();
-            return basic_any<String>::const_iterator{};
     }
 }
 
-template <typename String>
-typename basic_any<String>::const_iterator
-basic_any<String>::erase(const_iterator first, const_iterator last)
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::const_iterator
+basic_any<String, Allocator, Objects>::erase(const_iterator it)
 {
     switch (_type)
     {
         case json_array:
-            return _data._array.erase(first, last);
+        {
+            // it may be in the array this one shares
+            const auto index = it - _data.as_array().cbegin();
+            auto& elements = _mutable_array();
+            return elements.erase(elements.cbegin() + index);
+        }
+        case json_null:
+        case json_bool:
+        case json_integer:
+        case json_real:
+        case json_string:
+        case json_object:
+            _throw_invalid_type();
+            return basic_any::const_iterator{};
+    }
+}
+
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::const_iterator
+basic_any<String, Allocator, Objects>::erase(const_iterator first,
+                                             const_iterator last)
+{
+    switch (_type)
+    {
+        case json_array:
+        {
+            // the range may be in the array this one shares
+            const auto begin = _data.as_array().cbegin();
+            const auto first_index = first - begin;
+            const auto last_index = last - begin;
+            auto& elements = _mutable_array();
+            return elements.erase(elements.cbegin() + first_index,
+                                  elements.cbegin() + last_index);
+        }
         case json_null:
         case json_bool:
         case json_integer:
@@ -893,24 +1429,96 @@ basic_any<String>::erase(const_iterator first, const_iterator last)
         case json_string:
         case json_object:
             _throw_invalid_type();
-            return basic_any<String>::const_iterator{};
+            return basic_any::const_iterator{};
     }
 }
 
 //
 // object access
 //
-template <typename String>
-basic_any<String>& basic_any<String>::operator[](const String& key)
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::operator[](const String& key)
+{
+    auto& data = _leaked_object();
+    const auto size = data.items.size();
+    auto& result = data.items[key];
+    if (data.items.size() != size)
+    {
+        data.invalidate();
+    }
+    return result;
+}
+
+template <typename String, typename Allocator, typename Objects>
+const basic_any<String, Allocator, Objects>&
+basic_any<String, Allocator, Objects>::operator[](const String& key) const
 {
-    return _data._object[key];
+    const auto it = _data.as_object().items.find(key);
+    if (it == _data.as_object().items.end())
+    {
+        throw std::out_of_range(
+            "basic_any<String>::operator[] key out of range");
+    }
+    return it->second;
 }
 
-template <typename String>
-const basic_any<String>& basic_any<String>::operator[](const String& key) const
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::object::const_iterator
+basic_any<String, Allocator, Objects>::find(const String& key) const
 {
-    const auto it = _data._object.find(key);
-    if (it == _data._object.end())
+    switch (_type)
+    {
+        case json_null:
+        case json_bool:
+        case json_integer:
+        case json_real:
+        case json_string:
+        case json_array:
+            _throw_invalid_type();
+        case json_object:
+            break;
+    }
+
+    auto it = _data.as_object().items.find(key);
+    if (it == _data.as_object().items.end())
+    {
+        return typename object::const_iterator{};
+    }
+    return it;
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Key>
+typename std::enable_if<detail::lookup_key<Key>::value,
+                        basic_any<String, Allocator, Objects>&>::type
+basic_any<String, Allocator, Objects>::operator[](const Key& key)
+{
+    using lookup = detail::lookup_key<Key>;
+
+    auto& data = _leaked_object();
+    const auto it = data.items.find(lookup::template make<String>(key));
+    if (it != data.items.end())
+    {
+        return it->second;
+    }
+
+    // the member owns its key
+    data.invalidate();
+    return data.items[detail::string_factory<String, Allocator>::make(
+        lookup::data(key), lookup::size(key))];
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Key>
+typename std::enable_if<detail::lookup_key<Key>::value,
+                        const basic_any<String, Allocator, Objects>&>::type
+basic_any<String, Allocator, Objects>::operator[](const Key& key) const
+{
+    const auto& items = _data.as_object().items;
+    const auto it =
+        items.find(detail::lookup_key<Key>::template make<String>(key));
+    if (it == items.end())
     {
         throw std::out_of_range(
             "basic_any<String>::operator[] key out of range");
@@ -918,9 +1526,13 @@ const basic_any<String>& basic_any<String>::operator[](const String& key) const
     return it->second;
 }
 
-template <typename String>
-typename basic_any<String>::object::const_iterator
-basic_any<String>::find(const String& key) const
+template <typename String, typename Allocator, typename Objects>
+template <typename Key>
+typename std::enable_if<
+    detail::lookup_key<Key>::value,
+    typename basic_any<String, Allocator,
+                       Objects>::object::const_iterator>::type
+basic_any<String, Allocator, Objects>::find(const Key& key) const
 {
     switch (_type)
     {
@@ -935,16 +1547,17 @@ basic_any<String>::find(const String& key) const
             break;
     }
 
-    auto it = _data._object.find(key);
-    if (it == _data._object.end())
+    const auto& items = _data.as_object().items;
+    auto it = items.find(detail::lookup_key<Key>::template make<String>(key));
+    if (it == items.end())
     {
         return typename object::const_iterator{};
     }
     return it;
 }
 
-template <typename String>
-std::size_t basic_any<String>::erase(const String& key)
+template <typename String, typename Allocator, typename Objects>
+std::size_t basic_any<String, Allocator, Objects>::erase(const String& key)
 {
     switch (_type)
     {
@@ -956,13 +1569,17 @@ std::size_t basic_any<String>::erase(const String& key)
         case json_array:
             _throw_invalid_type();
         case json_object:
-            return _data._object.erase(key);
+        {
+            auto& data = _mutable_object();
+            data.invalidate();
+            return data.items.erase(key);
+        }
     }
 }
 
-template <typename String>
-typename basic_any<String>::object::const_iterator
-basic_any<String>::erase(typename object::const_iterator it)
+template <typename String, typename Allocator, typename Objects>
+typename basic_any<String, Allocator, Objects>::object::const_iterator
+basic_any<String, Allocator, Objects>::erase(typename object::const_iterator it)
 {
     switch (_type)
     {
@@ -974,13 +1591,25 @@ basic_any<String>::erase(typename object::const_iterator it)
         case json_array:
             _throw_invalid_type();
         case json_object:
-            return _data._object.erase(it);
+        {
+            if (_data._object->shared_count.load(std::memory_order_acquire) !=
+                1)
+            {
+                // it is in the object this one shares
+                const auto key = it->first;
+                it = _mutable_object().items.find(key);
+            }
+            auto& data = _mutable_object();
+            data.invalidate();
+            return data.items.erase(it);
+        }
     }
 }
 
-template <typename String>
-basic_any<String>::object_range<typename basic_any<String>::object_key_iterator>
-basic_any<String>::keys() const
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::object_range<
+    typename basic_any<String, Allocator, Objects>::object_key_iterator>
+basic_any<String, Allocator, Objects>::keys() const
 {
     switch (_type)
     {
@@ -992,14 +1621,14 @@ basic_any<String>::keys() const
         case json_array:
             _throw_invalid_type();
         case json_object:
-            return object_range<object_key_iterator>{&_data._object};
+            return object_range<object_key_iterator>{&_data.as_object().items};
     }
 }
 
-template <typename String>
-basic_any<String>::object_range<
-    typename basic_any<String>::object_value_iterator>
-basic_any<String>::values() const
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::object_range<
+    typename basic_any<String, Allocator, Objects>::object_value_iterator>
+basic_any<String, Allocator, Objects>::values() const
 {
     switch (_type)
     {
@@ -1011,14 +1640,15 @@ basic_any<String>::values() const
         case json_array:
             _throw_invalid_type();
         case json_object:
-            return object_range<object_value_iterator>{&_data._object};
+            return object_range<object_value_iterator>{
+                &_data.as_object().items};
     }
 }
 
-template <typename String>
-basic_any<String>::object_range<
-    typename basic_any<String>::object_item_iterator>
-basic_any<String>::items() const
+template <typename String, typename Allocator, typename Objects>
+basic_any<String, Allocator, Objects>::object_range<
+    typename basic_any<String, Allocator, Objects>::object_item_iterator>
+basic_any<String, Allocator, Objects>::items() const
 {
     switch (_type)
     {
@@ -1030,15 +1660,78 @@ basic_any<String>::items() const
         case json_array:
             _throw_invalid_type();
         case json_object:
-            return object_range<object_item_iterator>{&_data._object};
+            return object_range<object_item_iterator>{&_data.as_object().items};
+    }
+}
+
+//
+// hashing
+//
+template <typename String, typename Allocator, typename Objects>
+std::size_t basic_any<String, Allocator, Objects>::hash() const
+{
+    switch (_type)
+    {
+        case json_null:
+            return detail::hash_combine(json_null, 0);
+        case json_bool:
+            return detail::hash_combine(json_bool, _data._bool);
+        case json_integer:
+            return detail::hash_combine(json_integer,
+                                        std::hash<long long>{}(_int_value()));
+        case json_real:
+        {
+            // -0.0 == 0.0
+            const auto value = _double_value();
+            return detail::hash_combine(
+                json_real, std::hash<double>{}(value == 0.0 ? 0.0 : value));
+        }
+        case json_string:
+            return _node_hash(_data._string, [this]() -> std::size_t
+                              {
+                                  return detail::hash_combine(
+                                      json_string, std::hash<string_type>{}(
+                                                       _data.as_string()));
+                              });
+        case json_array:
+            return _node_hash(_data._array, [this]() -> std::size_t
+                              {
+                                  const auto& elements = _data.as_array();
+                                  auto result = detail::hash_combine(
+                                      json_array, elements.size());
+                                  for (const auto& element : elements)
+                                  {
+                                      result = detail::hash_combine(
+                                          result, element.hash());
+                                  }
+                                  return result;
+                              });
+        case json_object:
+            // members are summed, so their order doesn't matter
+            return _node_hash(_data._object, [this]() -> std::size_t
+                              {
+                                  const auto& items = _data.as_object().items;
+                                  std::size_t members = 0;
+                                  for (const auto& item : items)
+                                  {
+                                      members += detail::hash_combine(
+                                          std::hash<string_type>{}(item.first),
+                                          item.second.hash());
+                                  }
+                                  return detail::hash_combine(
+                                      detail::hash_combine(json_object,
+                                                           items.size()),
+                                      members);
+                              });
     }
 }
 
 //
 // operators
 //
-template <typename String>
-bool basic_any<String>::operator==(const basic_any<String>& right) const
+template <typename String, typename Allocator, typename Objects>
+bool basic_any<String, Allocator, Objects>::operator==(
+    const basic_any& right) const
 {
     if (_type != right._type)
     {
@@ -1051,26 +1744,34 @@ bool basic_any<String>::operator==(const basic_any<String>& right) const
         case json_bool:
             return _data._bool == right._data._bool;
         case json_integer:
-            return _data._int == right._data._int;
+            return _int_value() == right._int_value();
         case json_real:
-            return _data._double == right._data._double;
+            return _double_value() == right._double_value();
         case json_string:
-            return _data._string == right._data._string;
+            return _data._string == right._data._string ||
+                   (!_hashes_differ(_data._string, right._data._string) &&
+                    _data.as_string() == right._data.as_string());
         case json_array:
-            return _data._array == right._data._array;
+            return _data._array == right._data._array ||
+                   (!_hashes_differ(_data._array, right._data._array) &&
+                    _data.as_array() == right._data.as_array());
         case json_object:
-            return _data._object == right._data._object;
+            return _data._object == right._data._object ||
+                   (!_hashes_differ(_data._object, right._data._object) &&
+                    _data.as_object().items == right._data.as_object().items);
     }
 }
 
-template <typename String>
-inline bool basic_any<String>::operator!=(const basic_any<String>& right) const
+template <typename String, typename Allocator, typename Objects>
+inline bool
+basic_any<String, Allocator, Objects>::operator!=(const basic_any& right) const
 {
-    return *this != right;
+    return !(*this == right);
 }
 
-template <typename String>
-bool basic_any<String>::operator<(const basic_any<String>& right) const
+template <typename String, typename Allocator, typename Objects>
+bool basic_any<String, Allocator, Objects>::operator<(
+    const basic_any& right) const
 {
     if (_type != right._type)
     {
@@ -1084,45 +1785,63 @@ bool basic_any<String>::operator<(const basic_any<String>& right) const
         case json_bool:
             return _data._bool < right._data._bool;
         case json_integer:
-            return _data._int < right._data._int;
+            return _int_value() < right._int_value();
         case json_real:
-            return _data._double < right._data._double;
+            return _double_value() < right._double_value();
         case json_string:
-            return _data._string < right._data._string;
+            return _data._string != right._data._string &&
+                   _data.as_string() < right._data.as_string();
         case json_array:
-            return _data._array < right._data._array;
+            return _data._array != right._data._array &&
+                   _data.as_array() < right._data.as_array();
         case json_object:
             return false;
     }
 }
 
-template <typename String>
-inline bool basic_any<String>::operator>(const basic_any<String>& right) const
+template <typename String, typename Allocator, typename Objects>
+inline bool
+basic_any<String, Allocator, Objects>::operator>(const basic_any& right) const
 {
     return right < *this;
 }
 
-template <typename String>
-inline bool basic_any<String>::operator<=(const basic_any<String>& right) const
+template <typename String, typename Allocator, typename Objects>
+inline bool
+basic_any<String, Allocator, Objects>::operator<=(const basic_any& right) const
 {
     return !(right < *this);
 }
 
-template <typename String>
-inline bool basic_any<String>::operator>=(const basic_any<String>& right) const
+template <typename String, typename Allocator, typename Objects>
+inline bool
+basic_any<String, Allocator, Objects>::operator>=(const basic_any& right) const
 {
     return !(*this < right);
 }
 
-template <typename String>
-void basic_any<String>::_throw_invalid_type() const
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::_throw_invalid_type() const
 {
     throw std::logic_error("invalid type");
 }
 
-template <typename String>
+template <typename String, typename Allocator, typename Objects>
+inline long long basic_any<String, Allocator, Objects>::_int_value() const
+{
+    return _raw ? _data.as_number().int_value() : _data._int;
+}
+
+template <typename String, typename Allocator, typename Objects>
+inline double basic_any<String, Allocator, Objects>::_double_value() const
+{
+    return _raw ? _data.as_number().double_value() : _data._double;
+}
+
+template <typename String, typename Allocator, typename Objects>
 template <typename Writer>
-void basic_any<String>::_dump(Writer& writer, bool sort_keys) const
+void basic_any<String, Allocator, Objects>::_dump(Writer& writer,
+                                                  bool sort_keys) const
 {
     switch (_type)
     {
@@ -1133,40 +1852,36 @@ void basic_any<String>::_dump(Writer& writer, bool sort_keys) const
             writer.append(_data._bool);
             break;
         case json_integer:
-            writer.append(_data._int);
-            break;
         case json_real:
-            writer.append(_data._double);
+            if (_raw)
+            {
+                detail::append_number(writer, _data.as_number(), 0);
+            }
+            else if (_type == json_integer)
+            {
+                writer.append(_data._int);
+            }
+            else
+            {
+                writer.append(_data._double);
+            }
             break;
         case json_string:
-            writer.append(_data._string);
+            writer.append(_data.as_string());
             break;
         case json_array:
-            writer.open_array();
-            for (const auto& element : _data._array)
+            detail::open_array(writer, _data.as_array().size(), 0);
+            for (const auto& element : _data.as_array())
             {
                 element._dump(writer, sort_keys);
             }
             writer.close_array();
             break;
         case json_object:
-            writer.open_object();
+            detail::open_object(writer, _data.as_object().items.size(), 0);
             if (sort_keys)
             {
-                std::vector<const typename object::value_type*> items;
-                items.reserve(_data._object.size());
-                for (const auto& element : _data._object)
-                {
-                    items.push_back(&element);
-                }
-
-                std::sort(items.begin(), items.end(),
-                          [](const typename object::value_type* left,
-                             const typename object::value_type* right)
-                          {
-                    return left->first < right->first;
-                });
-                for (const auto& element : items)
+                for (const auto& element : _data.as_object().sorted())
                 {
                     writer.key(element->first);
                     element->second._dump(writer, sort_keys);
@@ -1174,7 +1889,7 @@ void basic_any<String>::_dump(Writer& writer, bool sort_keys) const
             }
             else
             {
-                for (const auto& element : _data._object)
+                for (const auto& element : _data.as_object().items)
                 {
                     writer.key(element.first);
                     element.second._dump(writer, sort_keys);
@@ -1185,16 +1900,18 @@ void basic_any<String>::_dump(Writer& writer, bool sort_keys) const
     }
 }
 
-template <typename String>
-void basic_any<String>::dump(std::ostream& ostr, bool sort_keys,
-                             std::size_t indent) const
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::dump(std::ostream& ostr,
+                                                 bool sort_keys,
+                                                 std::size_t indent) const
 {
     writer<std::ostream> writer{ostr, indent};
     _dump(writer, sort_keys);
 }
 
-template <typename String>
-String basic_any<String>::dump(bool sort_keys, std::size_t indent) const
+template <typename String, typename Allocator, typename Objects>
+String basic_any<String, Allocator, Objects>::dump(bool sort_keys,
+                                                   std::size_t indent) const
 {
     using stream_type = typename ::native::detail::stream_type<String>::type;
     stream_type ostr;
@@ -1203,91 +1920,457 @@ String basic_any<String>::dump(bool sort_keys, std::size_t indent) const
     return ostr.str();
 }
 
-template <typename String>
-void basic_any<String>::dump(std::string& str, bool sort_keys,
-                             std::size_t indent) const
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::dump(std::string& str,
+                                                 bool sort_keys,
+                                                 std::size_t indent) const
 {
-    std::ostringstream ostr;
-    writer<std::ostringstream> writer{ostr, indent};
+    // str is only replaced once the whole value is written
+    std::string result;
+    string_stream<> ostr{result};
+    writer<string_stream<>> writer{ostr, indent};
     _dump(writer, sort_keys);
-    str = ostr.str();
+    str.swap(result);
 }
 
-template <typename String>
-class basic_any<String>::handler
+template <typename String, typename Allocator, typename Objects>
+template <typename Stream, std::size_t InlineDepth>
+void basic_any<String, Allocator, Objects>::dump(
+    writer<Stream, InlineDepth>& writer, bool sort_keys) const
+{
+    _dump(writer, sort_keys);
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Stream>
+void basic_any<String, Allocator, Objects>::dump(
+    msgpack::writer<Stream>& writer, bool sort_keys) const
+{
+    _dump(writer, sort_keys);
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Stream>
+void basic_any<String, Allocator, Objects>::dump(cbor::writer<Stream>& writer,
+                                                 bool sort_keys) const
+{
+    _dump(writer, sort_keys);
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Stream>
+void basic_any<String, Allocator, Objects>::dump(
+    canonical_writer<Stream>& writer) const
+{
+    _dump_canonical(writer);
+}
+
+template <typename String, typename Allocator, typename Objects>
+String basic_any<String, Allocator, Objects>::dump_canonical() const
+{
+    using stream_type = typename ::native::detail::stream_type<String>::type;
+    stream_type ostr;
+    canonical_writer<stream_type> writer{ostr};
+    _dump_canonical(writer);
+    return ostr.str();
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Stream>
+void basic_any<String, Allocator, Objects>::_dump_canonical(
+    canonical_writer<Stream>& writer) const
+{
+    switch (_type)
+    {
+        case json_null:
+            writer.append(nullptr);
+            break;
+        case json_bool:
+            writer.append(_data._bool);
+            break;
+        case json_integer:
+            writer.append(_int_value());
+            break;
+        case json_real:
+            writer.append(_double_value());
+            break;
+        case json_string:
+            writer.append(_data.as_string());
+            break;
+        case json_array:
+            writer.open_array();
+            for (const auto& element : _data.as_array())
+            {
+                element._dump_canonical(writer);
+            }
+            writer.close_array();
+            break;
+        case json_object:
+        {
+            // the cached order is by bytes, which is nearly always the same,
+            // so the writer doesn't have to buffer and sort the members
+            const auto* order = &_data.as_object().sorted();
+            sorted_items resorted;
+            if (!std::is_sorted(order->begin(), order->end(),
+                                detail::utf16_key_less{}))
+            {
+                resorted = *order;
+                std::sort(resorted.begin(), resorted.end(),
+                          detail::utf16_key_less{});
+                order = &resorted;
+            }
+
+            writer.open_sorted_object();
+            for (const auto* element : *order)
+            {
+                writer.key(element->first);
+                element->second._dump_canonical(writer);
+            }
+            writer.close_object();
+            break;
+        }
+    }
+}
+
+template <typename String, typename Allocator, typename Objects>
+String basic_any<String, Allocator, Objects>::dump_parallel(
+    bool sort_keys, std::size_t indent, unsigned threads) const
+{
+    using stream_type = typename ::native::detail::stream_type<String>::type;
+    stream_type ostr;
+    _dump_parallel(ostr, sort_keys, indent, threads);
+    return ostr.str();
+}
+
+template <typename String, typename Allocator, typename Objects>
+void basic_any<String, Allocator, Objects>::dump_parallel(
+    std::string& str, bool sort_keys, std::size_t indent,
+    unsigned threads) const
+{
+    std::string result;
+    string_stream<> ostr{result};
+    _dump_parallel(ostr, sort_keys, indent, threads);
+    str.swap(result);
+}
+
+template <typename String, typename Allocator, typename Objects>
+template <typename Stream>
+void basic_any<String, Allocator, Objects>::_dump_parallel(
+    Stream& ostr, bool sort_keys, std::size_t indent, unsigned threads) const
+{
+    if (!threads)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    writer<Stream> writer{ostr, indent};
+    _dump_parallel(writer, ostr, sort_keys, indent, 0, threads);
+}
+
+// Containers with fewer elements than threads are written in order, looking
+// for a larger one further down. The first one that is large enough has its
+// elements split into chunks, which a fixed set of threads takes in turn. The
+// calling thread writes the first chunk directly and the rest are written to
+// buffers with writers that resume at the same depth, then written out once
+// each, in order.
+template <typename String, typename Allocator, typename Objects>
+template <typename Writer, typename Stream>
+void basic_any<String, Allocator, Objects>::_dump_parallel(
+    Writer& writer, Stream& ostr, bool sort_keys, std::size_t indent,
+    std::size_t depth, unsigned threads) const
+{
+    if (_type != json_array && _type != json_object)
+    {
+        _dump(writer, sort_keys);
+        return;
+    }
+
+    // keys are null for arrays
+    using element = std::pair<const string_type*, const basic_any*>;
+    std::vector<element> elements;
+    if (_type == json_array)
+    {
+        writer.open_array();
+        elements.reserve(_data.as_array().size());
+        for (const auto& value : _data.as_array())
+        {
+            elements.emplace_back(nullptr, &value);
+        }
+    }
+    else
+    {
+        writer.open_object();
+        elements.reserve(_data.as_object().items.size());
+        if (sort_keys)
+        {
+            for (const auto* item : _data.as_object().sorted())
+            {
+                elements.emplace_back(&item->first, &item->second);
+            }
+        }
+        else
+        {
+            for (const auto& item : _data.as_object().items)
+            {
+                elements.emplace_back(&item.first, &item.second);
+            }
+        }
+    }
+
+    if (threads < 2 || elements.size() < threads)
+    {
+        for (const auto& item : elements)
+        {
+            if (item.first)
+            {
+                writer.key(*item.first);
+            }
+            item.second->_dump_parallel(writer, ostr, sort_keys, indent,
+                                        depth + 1, threads);
+        }
+    }
+    else
+    {
+        // more chunks than threads, so a thread with small elements can
+        // take another chunk instead of waiting on a thread with large ones
+        const auto chunk_size =
+            std::max<std::size_t>(elements.size() / (threads * 4), 1);
+        const auto chunk_count =
+            (elements.size() + chunk_size - 1) / chunk_size;
+        const auto is_object = _type == json_object;
+
+        std::vector<std::string> buffers(chunk_count);
+        std::vector<std::exception_ptr> errors(chunk_count);
+        std::atomic<std::size_t> next{1};
+        const auto work = [&]
+        {
+            for (auto chunk = next++; chunk < chunk_count; chunk = next++)
+            {
+                try
+                {
+                    string_stream<> chunk_ostr{buffers[chunk]};
+                    json::writer<string_stream<>> chunk_writer{chunk_ostr,
+                                                               indent};
+                    chunk_writer.resume(is_object, depth + 1, true);
+                    const auto last =
+                        std::min((chunk + 1) * chunk_size, elements.size());
+                    for (auto i = chunk * chunk_size; i < last; ++i)
+                    {
+                        if (elements[i].first)
+                        {
+                            chunk_writer.key(*elements[i].first);
+                        }
+                        elements[i].second->_dump(chunk_writer, sort_keys);
+                    }
+                }
+                catch (...)
+                {
+                    errors[chunk] = std::current_exception();
+                }
+            }
+        };
+
+        // the calling thread writes the first chunk directly, then helps
+        // with the rest
+        std::vector<std::thread> workers;
+        std::exception_ptr error;
+        try
+        {
+            const auto count =
+                std::min<std::size_t>(threads - 1, chunk_count - 1);
+            workers.reserve(count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                workers.emplace_back(work);
+            }
+
+            for (std::size_t i = 0; i < chunk_size; ++i)
+            {
+                if (elements[i].first)
+                {
+                    writer.key(*elements[i].first);
+                }
+                elements[i].second->_dump(writer, sort_keys);
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+            next = chunk_count;
+        }
+        work();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+
+        for (std::size_t chunk = 1; chunk < chunk_count; ++chunk)
+        {
+            if (errors[chunk])
+            {
+                std::rethrow_exception(errors[chunk]);
+            }
+            ostr.write(buffers[chunk].data(), buffers[chunk].size());
+            std::string{}.swap(buffers[chunk]);
+        }
+    }
+
+    if (_type == json_array)
+    {
+        writer.close_array();
+    }
+    else
+    {
+        writer.close_object();
+    }
+}
+
+template <typename String, typename Allocator, typename Objects>
+class basic_any<String, Allocator, Objects>::handler
 {
 public:
     using char_type = char;
+    using size_hints = std::vector<std::size_t>;
+
+    handler(basic_any& self, number_mode numbers = number_convert)
+        : _root{self}
+        , _numbers{numbers}
+    {
+    }
 
-    handler(basic_any<String>& self)
+    // Reserves each array and object with the size the one in the same
+    // position had in a similar document, as recorded by sizes().
+    handler(basic_any& self, size_hints hints,
+            number_mode numbers = number_convert)
         : _root{self}
+        , _hints{std::move(hints)}
+        , _numbers{numbers}
     {
     }
 
     template <typename T>
     void value(T&& value)
     {
-        auto& target = _stack.empty() ? _root : _stack.back().second;
-
-        switch (target.type())
-        {
-            case json_null:
-            case json_bool:
-            case json_integer:
-            case json_real:
-            case json_string:
-                target = value;
-                break;
-            case json_array:
-                target.push_back(value);
-                break;
-            case json_object:
-                target[_key] = value;
-                break;
-        }
+        _insert(basic_any{std::forward<T>(value)});
     }
 
     void value(const char_type* val, std::size_t length)
     {
-        value(string_type{val, length});
+        _insert(basic_any{_make_string(val, length)});
     }
 
-    data_type start_array()
+    // With number_lazy, the parser passes numbers here as text.
+    void number(const char_type* text, std::size_t length)
     {
-        _stack.emplace_back(string_type{_key, _key_length},
-                            basic_any{json_array});
-        return type_unknown;
+        basic_any value;
+        value._data._number = _make<number_data>(_make_string(text, length));
+        value._type = value._data.as_number().real ? json_real : json_integer;
+        value._raw = true;
+        _insert(std::move(value));
     }
 
-    void end_array()
+    data_type start_array()
     {
-        auto val = std::move(_stack.back());
-        _stack.pop_back();
-        _key = val.first.data();
-        _key_length = val.first.size();
-        value(std::move(val.second));
+        _open(json_array);
+        return _expected();
     }
 
-    void start_object()
-    {
-        _stack.emplace_back(string_type{_key, _key_length},
-                            basic_any{json_object});
-    }
+    void end_array() { _close(); }
+
+    void start_object() { _open(json_object); }
 
-    void end_object() { end_array(); }
+    void end_object() { _close(); }
 
     data_type key(const char_type* key, std::size_t length)
     {
         _key = key;
         _key_length = length;
-        return type_unknown;
+        return _expected();
     }
 
+    // The size of every array and object, in the order they were started.
+    const size_hints& sizes() const { return _sizes; }
+
 private:
-    basic_any<String>& _root;
-    std::vector<std::pair<string_type, basic_any<String>>> _stack;
-    const char_type* _key = nullptr;
+    struct frame
+    {
+        basic_any* container;
+        std::size_t position; // in _sizes
+    };
+
+    data_type _expected() const
+    {
+        return _numbers == number_lazy ? type_number : type_unknown;
+    }
+
+    static string_type _make_string(const char_type* s, std::size_t length)
+    {
+        return detail::string_factory<String, Allocator>::make(s, length);
+    }
+
+    // Moves value to where it belongs in the innermost open container. That
+    // container was made by this handler, so there's no sorted order to
+    // invalidate, and nothing is added to its parent until it is closed, so
+    // pointers to it stay valid.
+    basic_any& _insert(basic_any&& value)
+    {
+        if (_stack.empty())
+        {
+            return _root = std::move(value);
+        }
+
+        auto& parent = *_stack.back().container;
+        if (parent._type == json_array)
+        {
+            auto& elements = parent._data.as_array();
+            elements.emplace_back(std::move(value));
+            return elements.back();
+        }
+
+        // keys from the CBOR parser aren't null terminated
+        auto& result =
+            parent._data.as_object().items[_make_string(_key, _key_length)];
+        result = std::move(value);
+        return result;
+    }
+
+    void _open(element_type type)
+    {
+        auto& container = _insert(basic_any{type});
+        const auto position = _sizes.size();
+        if (position < _hints.size())
+        {
+            if (type == json_array)
+            {
+                container._data.as_array().reserve(_hints[position]);
+            }
+            else
+            {
+                container._data.as_object().items.reserve(_hints[position]);
+            }
+        }
+        _sizes.push_back(0);
+        _stack.push_back(frame{&container, position});
+    }
+
+    void _close()
+    {
+        const auto& top = _stack.back();
+        _sizes[top.position] = top.container->size();
+        _stack.pop_back();
+    }
+
+    basic_any& _root;
+    std::vector<frame> _stack;
+    size_hints _hints;
+    size_hints _sizes;
+    const char_type* _key = "";
     std::size_t _key_length = 0;
+    number_mode _numbers;
 };
 
 template <typename any_type, typename IStream>
@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_DETAIL_INLINE_STACK_H__
+#define NATIVE_JSON_DETAIL_INLINE_STACK_H__
+
+#include "native/config.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace native
+{
+namespace json
+{
+namespace detail
+{
+
+// A stack that keeps the first N elements inline and only allocates when it
+// grows deeper than that.
+template <typename T, std::size_t N>
+class inline_stack
+{
+public:
+    bool empty() const { return _size == 0; }
+
+    std::size_t size() const { return _size; }
+
+    T& back() { return _size <= N ? _inline[_size - 1] : _overflow.back(); }
+
+    const T& back() const
+    {
+        return _size <= N ? _inline[_size - 1] : _overflow.back();
+    }
+
+    void push_back(const T& value)
+    {
+        if (_size < N)
+        {
+            _inline[_size] = value;
+        }
+        else
+        {
+            _overflow.push_back(value);
+        }
+        ++_size;
+    }
+
+    void pop_back()
+    {
+        if (_size > N)
+        {
+            _overflow.pop_back();
+        }
+        --_size;
+    }
+
+private:
+    T _inline[N ? N : 1];
+    std::size_t _size = 0;
+    std::vector<T> _overflow;
+};
+
+} // namespace detail
+} // namespace json
+} // namespace native
+
+#endif
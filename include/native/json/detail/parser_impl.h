@@ -494,6 +494,12 @@ public:
                 //            throw unexpected_type(stream.line(),
                 //            stream.column());
                 return; // unexpected type...
+            case type_number:
+                if (parse_number_text(0))
+                {
+                    return;
+                }
+                break;
             case type_unknown:
                 break;
         }
@@ -595,6 +601,79 @@ public:
         }
     }
 
+    // Checks the number against the JSON grammar and passes its text to
+    // handler.number() unconverted, for handlers that have one.
+    template <typename H = handler_type>
+    auto parse_number_text(int) -> decltype(
+        std::declval<H&>().number(std::declval<const char_type*>(),
+                                  std::size_t{}),
+        bool())
+    {
+        string_buffer.clear();
+        if (stream.peek() == '-')
+        {
+            take_number_char();
+        }
+
+        if (stream.peek() == '0')
+        {
+            take_number_char();
+            if (stream.peek() >= '0' && stream.peek() <= '9')
+            {
+                throw std::range_error("Leading zeros are not allowed.");
+            }
+        }
+        else if (!take_digits())
+        {
+            throw std::range_error("Expected a digit");
+        }
+
+        if (stream.peek() == '.')
+        {
+            take_number_char();
+            if (!take_digits())
+            {
+                throw std::range_error("Expected digit after decimal.");
+            }
+        }
+
+        if (stream.peek() == 'e' || stream.peek() == 'E')
+        {
+            take_number_char();
+            if (stream.peek() == '+' || stream.peek() == '-')
+            {
+                take_number_char();
+            }
+            if (!take_digits())
+            {
+                throw std::range_error("Expected digit after exponent start");
+            }
+        }
+
+        const auto length = string_buffer.size();
+        string_buffer.push_back(0);
+        handler.number(&string_buffer[0], length);
+        return true;
+    }
+
+    bool parse_number_text(long) { return false; }
+
+    void take_number_char()
+    {
+        string_buffer.push_back(static_cast<char_type>(stream.peek()));
+        stream.next();
+    }
+
+    bool take_digits()
+    {
+        const auto length = string_buffer.size();
+        while (stream.peek() >= '0' && stream.peek() <= '9')
+        {
+            take_number_char();
+        }
+        return string_buffer.size() != length;
+    }
+
     template <typename T>
     void parse_real()
     {
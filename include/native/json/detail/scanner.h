@@ -0,0 +1,340 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_DETAIL_SCANNER_H__
+#define NATIVE_JSON_DETAIL_SCANNER_H__
+
+#include "native/config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define NATIVE_JSON_SSE2 1
+#endif
+
+#if defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+namespace native
+{
+namespace json
+{
+namespace detail
+{
+
+//
+// Structural scanner, after the first stage of simdjson
+// https://github.com/lemire/simdjson
+//
+// Input is classified 64 bytes at a time into bit masks (one bit per byte).
+// From these masks we can tell which quotes are escaped, which bytes are
+// inside of a string and where every token begins without looking at the
+// bytes one at a time.
+//
+
+enum char_class : unsigned char
+{
+    class_whitespace = 0x01,
+    class_structural = 0x02,
+    class_quote = 0x04,
+    class_backslash = 0x08,
+    class_control = 0x10,
+    class_non_ascii = 0x20,
+};
+
+// clang-format off
+static constexpr unsigned char char_classes[256] = {
+    /* 0 */ 16, 16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 16, 16, 17, 16, 16,
+    /* 1 */ 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16,
+    /* 2 */  1,  0,  4,  0,  0,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,
+    /* 3 */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  2,  0,  0,  0,  0,  0,
+    /* 4 */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 5 */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  2,  8,  2,  0,  0,
+    /* 6 */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 7 */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  2,  0,  2,  0,  0,
+    /* 8 */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* 9 */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* a */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* b */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* c */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* d */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* e */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+    /* f */ 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32, 32,
+};
+// clang-format on
+
+inline unsigned char char_class_of(char ch)
+{
+    return char_classes[static_cast<unsigned char>(ch)];
+}
+
+// Index of the lowest set bit. bits must not be zero.
+inline unsigned trailing_zeros(std::uint64_t bits)
+{
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(bits));
+#else
+    unsigned result = 0;
+    for (; !(bits & 1); bits >>= 1)
+    {
+        ++result;
+    }
+    return result;
+#endif
+}
+
+// Each bit of the result is the xor of all of the bits at or below it. A mask
+// of quotes becomes a mask of everything from an opening quote up to, but not
+// including, the closing quote.
+inline std::uint64_t prefix_xor(std::uint64_t bits)
+{
+#if defined(__PCLMUL__)
+    const __m128i all_ones = _mm_set1_epi8('\xff');
+    const __m128i result = _mm_clmulepi64_si128(
+        _mm_set_epi64x(0, static_cast<long long>(bits)), all_ones, 0);
+    return static_cast<std::uint64_t>(_mm_cvtsi128_si64(result));
+#else
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+#endif
+}
+
+// Bit masks for one 64 byte block.
+struct block_masks
+{
+    std::uint64_t whitespace;
+    std::uint64_t structural;
+    std::uint64_t quote;
+    std::uint64_t backslash;
+    std::uint64_t control;
+    std::uint64_t non_ascii;
+};
+
+#if defined(NATIVE_JSON_SSE2)
+inline std::uint64_t movemask(__m128i value, unsigned shift)
+{
+    return static_cast<std::uint64_t>(
+               static_cast<std::uint16_t>(_mm_movemask_epi8(value)))
+           << shift;
+}
+#endif
+
+// Classify 64 bytes. There must be 64 readable bytes at block.
+inline void classify(const char* block, block_masks& masks)
+{
+#if defined(NATIVE_JSON_SSE2)
+    masks = block_masks{0, 0, 0, 0, 0, 0};
+
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    const __m128i lower_case = _mm_set1_epi8(0x20);
+    const __m128i open_brace = _mm_set1_epi8('{');  // '[' | 0x20
+    const __m128i close_brace = _mm_set1_epi8('}'); // ']' | 0x20
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i last_control = _mm_set1_epi8(0x1f);
+
+    for (unsigned i = 0; i < 64; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(block + i));
+
+        const __m128i whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                         _mm_cmpeq_epi8(chunk, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, newline),
+                         _mm_cmpeq_epi8(chunk, carriage_return)));
+
+        const __m128i folded = _mm_or_si128(chunk, lower_case);
+        const __m128i structural = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open_brace),
+                         _mm_cmpeq_epi8(folded, close_brace)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, colon),
+                         _mm_cmpeq_epi8(chunk, comma)));
+
+        // unsigned chunk <= 0x1f
+        const __m128i control = _mm_cmpeq_epi8(
+            _mm_max_epu8(chunk, last_control), last_control);
+
+        masks.whitespace |= movemask(whitespace, i);
+        masks.structural |= movemask(structural, i);
+        masks.quote |= movemask(_mm_cmpeq_epi8(chunk, quote), i);
+        masks.backslash |= movemask(_mm_cmpeq_epi8(chunk, backslash), i);
+        masks.control |= movemask(control, i);
+        masks.non_ascii |= movemask(chunk, i);
+    }
+#else
+    masks = block_masks{0, 0, 0, 0, 0, 0};
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        const std::uint64_t bit = std::uint64_t{1} << i;
+        const auto ch = char_class_of(block[i]);
+        masks.whitespace |= (ch & class_whitespace) ? bit : 0;
+        masks.structural |= (ch & class_structural) ? bit : 0;
+        masks.quote |= (ch & class_quote) ? bit : 0;
+        masks.backslash |= (ch & class_backslash) ? bit : 0;
+        masks.control |= (ch & class_control) ? bit : 0;
+        masks.non_ascii |= (ch & class_non_ascii) ? bit : 0;
+    }
+#endif
+}
+
+// Returns the first character in [first, last) that can't be written to a
+// JSON string as is: a quote, backslash, control or (if non_ascii is true) a
+// non-ASCII character.
+inline const char* find_escape(const char* first, const char* last,
+                               bool non_ascii = true)
+{
+#if defined(NATIVE_JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i last_control = _mm_set1_epi8(0x1f);
+    const __m128i high_bit = _mm_set1_epi8(non_ascii ? '\x80' : 0);
+
+    for (; last - first >= 16; first += 16)
+    {
+        const __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        const __m128i escape = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                         _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(chunk, last_control),
+                                        last_control),
+                         _mm_and_si128(chunk, high_bit)));
+        const int mask = _mm_movemask_epi8(escape);
+        if (mask)
+        {
+            return first + trailing_zeros(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+    const unsigned char escape = class_quote | class_backslash |
+                                 class_control |
+                                 (non_ascii ? class_non_ascii : 0);
+    for (; first != last && !(char_class_of(*first) & escape); ++first)
+    {
+    }
+    return first;
+}
+
+// Tracks string state from one block to the next.
+class string_scanner
+{
+public:
+    // Returns the characters that are escaped by a backslash.
+    std::uint64_t escaped(std::uint64_t backslash)
+    {
+        // a backslash escaped by the previous block doesn't start an escape
+        backslash &= ~_prev_escaped;
+        const std::uint64_t follows_escape = backslash << 1 | _prev_escaped;
+
+        // get sequences starting on even bits by clearing out the odd series
+        // using addition
+        const std::uint64_t even_bits = 0x5555555555555555ULL;
+        const std::uint64_t odd_sequence_starts =
+            backslash & ~even_bits & ~follows_escape;
+        const std::uint64_t sequences_starting_on_even_bits =
+            odd_sequence_starts + backslash;
+        _prev_escaped = sequences_starting_on_even_bits < odd_sequence_starts;
+        const std::uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+
+        return (even_bits ^ invert_mask) & follows_escape;
+    }
+
+    // Returns a mask of every byte from an opening quote up to, but not
+    // including, the closing quote.
+    std::uint64_t in_string(std::uint64_t quote)
+    {
+        const std::uint64_t result = prefix_xor(quote) ^ _prev_in_string;
+        _prev_in_string = static_cast<std::uint64_t>(
+            static_cast<std::int64_t>(result) >> 63);
+        return result;
+    }
+
+    // True if the last block ended inside of a string.
+    bool unterminated() const { return _prev_in_string != 0; }
+
+private:
+    std::uint64_t _prev_escaped = 0;
+    std::uint64_t _prev_in_string = 0;
+};
+
+// A block that has been run through the string scanner.
+struct scanned_block
+{
+    block_masks masks;
+    std::uint64_t escaped;  // characters following an unescaped backslash
+    std::uint64_t quote;    // unescaped quotes
+    std::uint64_t in_string; // opening quote and string contents
+};
+
+// Run every 64 byte block in [first, first + length) through the scanner,
+// calling func(block, scanned, count) where count is the number of valid bytes
+// in the block. The last partial block is padded with spaces. func returns
+// false to stop the scan early.
+template <typename Func>
+bool scan_blocks(const char* first, std::size_t length, string_scanner& scanner,
+                 Func&& func)
+{
+    scanned_block scanned;
+    const auto scan = [&](const char* block, const char* classified,
+                          std::size_t count)
+    {
+        classify(classified, scanned.masks);
+        scanned.escaped = scanner.escaped(scanned.masks.backslash);
+        scanned.quote = scanned.masks.quote & ~scanned.escaped;
+        scanned.in_string = scanner.in_string(scanned.quote);
+        return func(block, static_cast<const scanned_block&>(scanned), count);
+    };
+
+    const char* const last = first + length;
+    for (; last - first >= 64; first += 64)
+    {
+        if (!scan(first, first, 64))
+        {
+            return false;
+        }
+    }
+
+    if (first != last)
+    {
+        char padded[64];
+        std::memset(padded, ' ', sizeof(padded));
+        std::memcpy(padded, first, static_cast<std::size_t>(last - first));
+        return scan(first, padded, static_cast<std::size_t>(last - first));
+    }
+
+    return true;
+}
+
+} // namespace detail
+} // namespace json
+} // namespace native
+
+#endif
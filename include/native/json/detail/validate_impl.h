@@ -0,0 +1,448 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_VALIDATE_IMPL_H__
+#define NATIVE_JSON_VALIDATE_IMPL_H__
+
+#include "native/config.h"
+
+#include "native/utf.h"
+
+#include "native/json/detail/scanner.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace native
+{
+namespace json
+{
+namespace detail
+{
+
+// One bit per nesting level: set for objects, clear for arrays. The first 64
+// levels don't allocate.
+class bit_stack
+{
+public:
+    void push(bool value)
+    {
+        if ((_size >> 6) > _overflow.size())
+        {
+            _overflow.push_back(0);
+        }
+        _set(_size++, value);
+    }
+
+    void pop() { --_size; }
+
+    bool top() const { return _get(_size - 1); }
+
+    std::size_t size() const { return _size; }
+
+private:
+    std::uint64_t& _word(std::size_t i)
+    {
+        return i < 64 ? _inline : _overflow[(i >> 6) - 1];
+    }
+
+    const std::uint64_t& _word(std::size_t i) const
+    {
+        return i < 64 ? _inline : _overflow[(i >> 6) - 1];
+    }
+
+    void _set(std::size_t i, bool value)
+    {
+        const std::uint64_t bit = std::uint64_t{1} << (i & 63);
+        auto& word = _word(i);
+        word = value ? (word | bit) : (word & ~bit);
+    }
+
+    bool _get(std::size_t i) const
+    {
+        return (_word(i) >> (i & 63)) & 1;
+    }
+
+    std::size_t _size = 0;
+    std::uint64_t _inline = 0;
+    std::vector<std::uint64_t> _overflow;
+};
+
+// Checks that a document is well-formed without calling a handler.
+//
+// Stage one is the structural scanner: strings are found and checked (control
+// characters, escapes) with bit masks, and every token start is located. Stage
+// two walks only the token starts with a small state machine that checks the
+// grammar. Nothing is copied and no numbers are converted.
+class validator
+{
+public:
+    validator(const char* source, std::size_t length, bool check_utf8,
+              std::size_t max_depth)
+        : _first{source}
+        , _last{source + length}
+        , _utf8_checked{source}
+        , _check_utf8{check_utf8}
+        , _max_depth{max_depth}
+    {
+    }
+
+    bool validate()
+    {
+        const auto valid = scan_blocks(
+            _first, static_cast<std::size_t>(_last - _first), _strings,
+            [this](const char* block, const scanned_block& scanned,
+                   std::size_t count)
+            {
+                return _block(block, scanned, count);
+            });
+
+        return valid && !_strings.unterminated() && _state == expect_end;
+    }
+
+private:
+    enum state : unsigned char
+    {
+        expect_document,
+        expect_value,
+        expect_value_or_close,
+        expect_key,
+        expect_key_or_close,
+        expect_colon,
+        expect_comma_or_close,
+        expect_end,
+    };
+
+    bool _block(const char* block, const scanned_block& scanned,
+                std::size_t count)
+    {
+        const auto& masks = scanned.masks;
+        const auto in_string = scanned.in_string;
+
+        // control characters are only allowed as whitespace between tokens
+        if (masks.control & (in_string | ~masks.whitespace))
+        {
+            return false;
+        }
+
+        // a backslash at the end of the input escapes a byte past it
+        const auto valid =
+            count < 64 ? (std::uint64_t{1} << count) - 1 : ~std::uint64_t{0};
+        auto escaped = scanned.escaped & in_string & valid;
+        for (; escaped; escaped &= escaped - 1)
+        {
+            if (!_escape(block + trailing_zeros(escaped)))
+            {
+                return false;
+            }
+        }
+
+        if (_check_utf8 && masks.non_ascii &&
+            !_utf8(block + trailing_zeros(masks.non_ascii), block + count))
+        {
+            return false;
+        }
+
+        const auto not_string = ~in_string;
+        const auto operators = masks.structural & not_string;
+        const auto open_quotes = scanned.quote & in_string;
+        const auto scalars =
+            ~(masks.structural | masks.whitespace | scanned.quote) & not_string;
+        const auto scalar_starts = scalars & ~(scalars << 1 | _prev_scalar);
+        _prev_scalar = scalars >> 63;
+
+        auto tokens = operators | open_quotes | scalar_starts;
+        for (; tokens; tokens &= tokens - 1)
+        {
+            if (!_token(block + trailing_zeros(tokens)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ch follows a backslash inside of a string.
+    bool _escape(const char* ch)
+    {
+        if (ch == _last)
+        {
+            return false;
+        }
+
+        switch (*ch)
+        {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                return true;
+            case 'u':
+                break;
+            default:
+                return false;
+        }
+
+        std::uint32_t codepoint = 0;
+        if (!_hex4(ch + 1, codepoint))
+        {
+            return false;
+        }
+
+        // handle utf-16 surrogate pair
+        if (codepoint >= 0xd800 && codepoint <= 0xdbff)
+        {
+            std::uint32_t codepoint2 = 0;
+            return _last - ch >= 11 && ch[5] == '\\' && ch[6] == 'u' &&
+                   _hex4(ch + 7, codepoint2) && codepoint2 >= 0xdc00 &&
+                   codepoint2 <= 0xdfff;
+        }
+        return true;
+    }
+
+    bool _hex4(const char* first, std::uint32_t& codepoint)
+    {
+        if (_last - first < 4)
+        {
+            return false;
+        }
+        for (const auto* p = first; p != first + 4; ++p)
+        {
+            codepoint <<= 4;
+            if (*p >= '0' && *p <= '9')
+            {
+                codepoint += *p - '0';
+            }
+            else if (*p >= 'a' && *p <= 'f')
+            {
+                codepoint += *p - 'a' + 10;
+            }
+            else if (*p >= 'A' && *p <= 'F')
+            {
+                codepoint += *p - 'A' + 10;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Validates from the first non-ASCII character in a block. A sequence may
+    // run past the end of the block, so we remember how far we've checked.
+    bool _utf8(const char* first, const char* last)
+    {
+        if (first < _utf8_checked)
+        {
+            first = _utf8_checked;
+        }
+        while (first < last)
+        {
+            first = utf8::validate_sequence(first, _last);
+            if (!first)
+            {
+                return false;
+            }
+        }
+        _utf8_checked = first;
+        return true;
+    }
+
+    bool _token(const char* p)
+    {
+        switch (_state)
+        {
+            case expect_document:
+                return (*p == '{' || *p == '[') && _open(*p);
+            case expect_value_or_close:
+                if (*p == ']')
+                {
+                    return _close(*p);
+                }
+            // fall through
+            case expect_value:
+                switch (*p)
+                {
+                    case '{':
+                    case '[':
+                        return _open(*p);
+                    case '"':
+                        _state = expect_comma_or_close;
+                        return true;
+                    case '}':
+                    case ']':
+                    case ':':
+                    case ',':
+                        return false;
+                    default:
+                        _state = expect_comma_or_close;
+                        return _scalar(p);
+                }
+            case expect_key_or_close:
+                if (*p == '}')
+                {
+                    return _close(*p);
+                }
+            // fall through
+            case expect_key:
+                _state = expect_colon;
+                return *p == '"';
+            case expect_colon:
+                _state = expect_value;
+                return *p == ':';
+            case expect_comma_or_close:
+                switch (*p)
+                {
+                    case ',':
+                        _state = _stack.top() ? expect_key : expect_value;
+                        return true;
+                    case '}':
+                    case ']':
+                        return _close(*p);
+                    default:
+                        return false;
+                }
+            case expect_end:
+                return false;
+        }
+        return false;
+    }
+
+    bool _open(char ch)
+    {
+        if (_max_depth && _stack.size() >= _max_depth)
+        {
+            return false;
+        }
+        _stack.push(ch == '{');
+        _state = ch == '{' ? expect_key_or_close : expect_value_or_close;
+        return true;
+    }
+
+    bool _close(char ch)
+    {
+        if (_stack.top() != (ch == '}'))
+        {
+            return false;
+        }
+        _stack.pop();
+        _state = _stack.size() ? expect_comma_or_close : expect_end;
+        return true;
+    }
+
+    bool _literal(const char* p, const char* literal, std::size_t length)
+    {
+        return static_cast<std::size_t>(_last - p) >= length &&
+               std::memcmp(p, literal, length) == 0 && _delimited(p + length);
+    }
+
+    bool _delimited(const char* p)
+    {
+        return p == _last ||
+               (char_class_of(*p) &
+                (class_whitespace | class_structural | class_quote));
+    }
+
+    static bool _digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+    // number = [ minus ] int [ frac ] [ exp ] (RFC 7159)
+    bool _scalar(const char* p)
+    {
+        switch (*p)
+        {
+            case 't':
+                return _literal(p, "true", 4);
+            case 'f':
+                return _literal(p, "false", 5);
+            case 'n':
+                return _literal(p, "null", 4);
+            default:
+                break;
+        }
+
+        if (*p == '-')
+        {
+            ++p;
+        }
+        if (p == _last)
+        {
+            return false;
+        }
+        if (*p == '0')
+        {
+            ++p;
+        }
+        else if (_digit(*p))
+        {
+            for (++p; p != _last && _digit(*p); ++p)
+            {
+            }
+        }
+        else
+        {
+            return false;
+        }
+
+        if (p != _last && *p == '.')
+        {
+            if (++p == _last || !_digit(*p))
+            {
+                return false;
+            }
+            for (++p; p != _last && _digit(*p); ++p)
+            {
+            }
+        }
+
+        if (p != _last && (*p == 'e' || *p == 'E'))
+        {
+            if (++p != _last && (*p == '+' || *p == '-'))
+            {
+                ++p;
+            }
+            if (p == _last || !_digit(*p))
+            {
+                return false;
+            }
+            for (++p; p != _last && _digit(*p); ++p)
+            {
+            }
+        }
+
+        return _delimited(p);
+    }
+
+    const char* _first;
+    const char* _last;
+    const char* _utf8_checked;
+    bool _check_utf8;
+    std::size_t _max_depth;
+    state _state = expect_document;
+    std::uint64_t _prev_scalar = 0;
+    string_scanner _strings;
+    bit_stack _stack;
+};
+
+} // namespace detail
+} // namespace json
+} // namespace native
+
+#endif
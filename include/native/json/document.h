@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_DOCUMENT_H__
+#define NATIVE_JSON_DOCUMENT_H__
+
+#include "native/config.h"
+
+#include "native/istring.h"
+
+#include "native/json/any.h"
+#include "native/json/arena.h"
+#include "native/json/parser.h"
+
+namespace native
+{
+namespace json
+{
+
+// A parsed document whose arrays, objects and strings all come from one
+// arena, so parsing takes a few large allocations instead of one for every
+// node, and they are freed together when the document is destroyed.
+//
+// Values in the document, and copies of them, must not outlive it. To add
+// to the document, make its arena current while doing so:
+//
+//     json::document doc;
+//     doc.parse(text);
+//     {
+//         json::arena::scope scope{doc.storage()};
+//         doc.root()["tags"] = json::document::value_type{json_array};
+//     }
+template <typename String>
+class basic_document
+{
+public:
+    using value_type = basic_any<String, arena_allocator<char>>;
+    using string_type = String;
+
+    explicit basic_document(std::size_t block_size = arena::default_block_size)
+        : _arena(block_size)
+    {
+    }
+
+    basic_document(const basic_document&) = delete;
+    basic_document& operator=(const basic_document&) = delete;
+
+    // Parses source into the root. Memory used by a previous root is only
+    // reclaimed by clear(). With number_lazy, the text of each number is
+    // kept in the arena and only converted if it's read.
+    template <typename Ch>
+    void parse(const Ch* source, std::size_t length,
+               number_mode numbers = number_convert)
+    {
+        arena::scope scope{_arena};
+        _root = value_type{};
+        typename value_type::handler handler{_root, numbers};
+        parser{}.parse(source, length, handler);
+    }
+
+    template <typename Source>
+    void parse(const Source& source, number_mode numbers = number_convert)
+    {
+        parse(source.data(), source.size(), numbers);
+    }
+
+    value_type& root() { return _root; }
+    const value_type& root() const { return _root; }
+
+    arena& storage() { return _arena; }
+    const arena& storage() const { return _arena; }
+
+    // Resets the root to null and frees the arena.
+    void clear()
+    {
+        _root = value_type{};
+        _arena.release();
+    }
+
+private:
+    arena _arena; // destroyed after _root
+    value_type _root;
+};
+
+using document = basic_document<istring>;
+
+} // namespace json
+} // namespace native
+
+#endif
@@ -0,0 +1,378 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_FROZEN_H__
+#define NATIVE_JSON_FROZEN_H__
+
+#include "native/config.h"
+
+#include "native/istring.h"
+
+#include "native/json/any.h"
+#include "native/json/arena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace native
+{
+namespace json
+{
+
+// An immutable copy of a value, made by freeze(). All of it is laid out in
+// one arena and its objects are flat_maps, so members sit next to each
+// other. Nothing in it changes once it's made, so any number of threads can
+// read it at once.
+//
+// Values read from it, and copies or shares of them, must not outlive it.
+template <typename String>
+class basic_frozen
+{
+public:
+    using value_type =
+        basic_any<String, arena_allocator<char>, ordered_objects>;
+    using string_type = String;
+
+    template <typename Allocator, typename Objects>
+    explicit basic_frozen(const basic_any<String, Allocator, Objects>& value,
+                          std::size_t block_size = arena::default_block_size);
+
+    basic_frozen(const basic_frozen&) = delete;
+    basic_frozen& operator=(const basic_frozen&) = delete;
+
+    const value_type& root() const { return _root; }
+    const arena& storage() const { return _arena; }
+
+private:
+    template <typename Any>
+    static value_type _copy(const Any& value);
+
+    arena _arena; // destroyed after _root
+    value_type _root;
+};
+
+using frozen = basic_frozen<istring>;
+
+// Lazily converted numbers are converted as they are frozen.
+template <typename String, typename Allocator, typename Objects>
+std::unique_ptr<const basic_frozen<String>>
+freeze(const basic_any<String, Allocator, Objects>& value);
+
+// Hands immutable values from a writer to readers on other threads, in the
+// style of RCU. acquire() takes a snapshot of the current value without
+// locking, and the snapshot keeps that value alive after it has been
+// replaced. A replaced value is deleted by whoever finishes with it last:
+// publish(), or the last snapshot of it to be destroyed.
+//
+// Any number of threads may acquire() at once. publish() may be called from
+// one thread at a time, and snapshots may outlive the publisher.
+template <typename T>
+class publisher
+{
+    struct entry;
+
+public:
+    class snapshot;
+
+    publisher() noexcept = default;
+    explicit publisher(std::unique_ptr<const T> value);
+    ~publisher();
+
+    publisher(const publisher&) = delete;
+    publisher& operator=(const publisher&) = delete;
+
+    // Replaces the current value, which may be null.
+    void publish(std::unique_ptr<const T> value);
+
+    snapshot acquire() const;
+
+private:
+    // The current entry and the number of snapshots taken of it are one
+    // word, so a reader takes a snapshot with a single atomic add. Pointers
+    // must fit in the low 48 bits; publish() throws if one doesn't.
+    static constexpr unsigned count_shift = 48;
+    static constexpr std::uint64_t one_reader = std::uint64_t{1}
+                                                << count_shift;
+    static constexpr std::uint64_t pointer_mask = one_reader - 1;
+
+    // Each reader that takes the count in the word to a multiple of
+    // fold_size moves that many into the entry. Folding readers can be held
+    // up, so past high_water every reader folds before it returns. The count
+    // can then only reach 1 << 16 with more than 1 << 15 threads inside
+    // acquire() at once.
+    static constexpr std::uint64_t fold_size = 1 << 8;
+    static constexpr std::uint64_t high_water = 1 << 15;
+
+    static std::uint64_t _pack(entry* pointer);
+    static entry* _entry(std::uint64_t word);
+    static void _retire(std::uint64_t word);
+    void _fold(entry* pointer) const;
+
+    mutable std::atomic<std::uint64_t> _current{0};
+};
+
+// A value published and the snapshots of it that were counted outside the
+// word. Until the value is replaced, owned stands in for the publisher's
+// hold on it, so releases can't take the count to zero early.
+template <typename T>
+struct publisher<T>::entry
+{
+    static constexpr std::int64_t owned = std::int64_t{1} << 40;
+
+    explicit entry(std::unique_ptr<const T> value)
+        : value{std::move(value)}
+    {
+    }
+
+    void release()
+    {
+        if (count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    std::unique_ptr<const T> value;
+    std::atomic<std::int64_t> count{owned};
+};
+
+// Keeps a published value alive. Move only.
+template <typename T>
+class publisher<T>::snapshot
+{
+public:
+    snapshot() noexcept = default;
+
+    snapshot(snapshot&& right) noexcept
+        : _entry{right._entry}
+    {
+        right._entry = nullptr;
+    }
+
+    snapshot& operator=(snapshot&& right) noexcept
+    {
+        if (this != &right)
+        {
+            reset();
+            _entry = right._entry;
+            right._entry = nullptr;
+        }
+        return *this;
+    }
+
+    ~snapshot() { reset(); }
+
+    const T* get() const { return _entry ? _entry->value.get() : nullptr; }
+    const T& operator*() const { return *get(); }
+    const T* operator->() const { return get(); }
+    explicit operator bool() const { return get() != nullptr; }
+
+    void reset()
+    {
+        if (_entry)
+        {
+            _entry->release();
+            _entry = nullptr;
+        }
+    }
+
+private:
+    friend publisher;
+
+    explicit snapshot(entry* pointer)
+        : _entry{pointer}
+    {
+    }
+
+    entry* _entry = nullptr;
+};
+
+//
+// implementation
+//
+
+template <typename String>
+template <typename Allocator, typename Objects>
+basic_frozen<String>::basic_frozen(
+    const basic_any<String, Allocator, Objects>& value,
+    std::size_t block_size)
+    : _arena{block_size}
+{
+    arena::scope scope{_arena};
+    _root = _copy(value);
+}
+
+// Arrays are sized once, so no space in the arena is left behind by growing
+// them.
+template <typename String>
+template <typename Any>
+typename basic_frozen<String>::value_type
+basic_frozen<String>::_copy(const Any& value)
+{
+    using factory = detail::string_factory<String, arena_allocator<char>>;
+
+    switch (value.type())
+    {
+        case json_null:
+            return value_type{};
+        case json_bool:
+            return value_type{value.bool_value()};
+        case json_integer:
+            return value_type{value.int_value()};
+        case json_real:
+            return value_type{static_cast<double>(value.double_value())};
+        case json_string:
+        {
+            const auto s = value.string_value();
+            return value_type{factory::make(s.data(), s.size())};
+        }
+        case json_array:
+        {
+            value_type result{json_array};
+            result.resize(value.size());
+            std::size_t i = 0;
+            for (const auto& element : value)
+            {
+                result[i++] = _copy(element);
+            }
+            return result;
+        }
+        case json_object:
+        {
+            typename value_type::object members;
+            members.reserve(value.size());
+            for (const auto& item : value.items())
+            {
+                members.emplace(
+                    factory::make(item.first.data(), item.first.size()),
+                    _copy(item.second));
+            }
+            return value_type{std::move(members)};
+        }
+    }
+    throw std::logic_error("invalid type");
+}
+
+template <typename String, typename Allocator, typename Objects>
+std::unique_ptr<const basic_frozen<String>>
+freeze(const basic_any<String, Allocator, Objects>& value)
+{
+    return std::unique_ptr<const basic_frozen<String>>{
+        new basic_frozen<String>{value}};
+}
+
+template <typename T>
+publisher<T>::publisher(std::unique_ptr<const T> value)
+{
+    publish(std::move(value));
+}
+
+template <typename T>
+publisher<T>::~publisher()
+{
+    _retire(_current.load(std::memory_order_acquire));
+}
+
+template <typename T>
+void publisher<T>::publish(std::unique_ptr<const T> value)
+{
+    std::unique_ptr<entry> next{value ? new entry{std::move(value)}
+                                      : nullptr};
+    const auto word = _pack(next.get());
+    _retire(_current.exchange(word, std::memory_order_acq_rel));
+    next.release();
+}
+
+template <typename T>
+typename publisher<T>::snapshot publisher<T>::acquire() const
+{
+    const auto word =
+        _current.fetch_add(one_reader, std::memory_order_acquire);
+    auto* pointer = _entry(word);
+    const auto count = (word >> count_shift) + 1;
+    if (pointer && (count % fold_size == 0 || count >= high_water))
+    {
+        _fold(pointer);
+    }
+    return snapshot{pointer};
+}
+
+template <typename T>
+inline std::uint64_t publisher<T>::_pack(entry* pointer)
+{
+    const auto word = static_cast<std::uint64_t>(
+        reinterpret_cast<std::uintptr_t>(pointer));
+    if (word & ~pointer_mask)
+    {
+        throw std::runtime_error("pointer doesn't fit in 48 bits");
+    }
+    return word;
+}
+
+template <typename T>
+inline typename publisher<T>::entry* publisher<T>::_entry(std::uint64_t word)
+{
+    return reinterpret_cast<entry*>(
+        static_cast<std::uintptr_t>(word & pointer_mask));
+}
+
+// The snapshots counted in the word move to the entry, along with the
+// publisher's hold on it.
+template <typename T>
+void publisher<T>::_retire(std::uint64_t word)
+{
+    auto* pointer = _entry(word);
+    if (!pointer)
+    {
+        return;
+    }
+
+    const auto readers = static_cast<std::int64_t>(word >> count_shift);
+    const auto moved = readers - entry::owned;
+    if (pointer->count.fetch_add(moved, std::memory_order_acq_rel) == -moved)
+    {
+        delete pointer;
+    }
+}
+
+// The entry is credited first, so the total never drops below the number of
+// live snapshots. If the entry was replaced meanwhile, _retire() has moved
+// the whole count, and if other readers have already folded what's in the
+// word, there's nothing to move. Either way the credit is taken back.
+template <typename T>
+void publisher<T>::_fold(entry* pointer) const
+{
+    const auto credit = static_cast<std::int64_t>(fold_size);
+    pointer->count.fetch_add(credit, std::memory_order_relaxed);
+
+    auto word = _current.load(std::memory_order_relaxed);
+    while (_entry(word) == pointer && (word >> count_shift) >= fold_size)
+    {
+        if (_current.compare_exchange_weak(word, word - fold_size * one_reader,
+                                           std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+    pointer->count.fetch_sub(credit, std::memory_order_relaxed);
+}
+
+} // namespace json
+} // namespace native
+
+#endif
@@ -39,6 +39,14 @@ namespace json
 //
 // If a value cannot be converted, then a std::range_error is thrown.
 //
+// A handler that returns type_number gets the number's text, checked but
+// not converted, through an extra method:
+//
+//     void number(const char_type* text, std::size_t length) {}
+//
+// Handlers without one get the number converted as for type_unknown, and so
+// does anything reading a binary format.
+//
 // Note that a handler does not have to derive from this handler. This means
 // that we can use template methods to pull out the values.
 //
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_MINIFY_H__
+#define NATIVE_JSON_MINIFY_H__
+
+#include "native/config.h"
+
+#include "native/string_base.h"
+#include "native/string_builder.h"
+
+#include "native/json/detail/scanner.h"
+
+#include <cstring>
+#include <string>
+
+namespace native
+{
+namespace json
+{
+namespace detail
+{
+
+// Calls out(first, length) for every run of bytes in source that is not
+// whitespace between tokens.
+template <typename Out>
+void minify_runs(const char* source, std::size_t length, Out&& out)
+{
+    string_scanner strings;
+    scan_blocks(source, length, strings,
+                [&](const char* block, const scanned_block& scanned,
+                    std::size_t count)
+                {
+                    std::uint64_t keep =
+                        ~(scanned.masks.whitespace & ~scanned.in_string);
+                    if (count < 64)
+                    {
+                        keep &= (std::uint64_t{1} << count) - 1;
+                    }
+
+                    while (keep)
+                    {
+                        const auto start = trailing_zeros(keep);
+                        const auto run = ~(keep >> start);
+                        const auto size =
+                            run ? trailing_zeros(run) : 64 - start;
+                        out(block + start, static_cast<std::size_t>(size));
+                        if (start + size == 64)
+                        {
+                            break;
+                        }
+                        keep &= ~std::uint64_t{0} << (start + size);
+                    }
+                    return true;
+                });
+}
+
+} // namespace detail
+
+// Removes whitespace between tokens, writing the result to dest and returning
+// its length. dest must have room for length characters and may be the same as
+// source to minify in place.
+//
+// The document is not validated. Whitespace inside of strings is kept, as are
+// escaped quotes, so a well-formed document stays well-formed.
+inline std::size_t minify(const char* source, std::size_t length, char* dest)
+{
+    char* out = dest;
+    detail::minify_runs(source, length,
+                        [&out](const char* first, std::size_t size)
+                        {
+                            std::memmove(out, first, size);
+                            out += size;
+                        });
+    return static_cast<std::size_t>(out - dest);
+}
+
+// Minifies text in place.
+inline void minify(std::string& text)
+{
+    if (!text.empty())
+    {
+        text.resize(minify(text.data(), text.size(), &text[0]));
+    }
+}
+
+// Appends the minified source to builder.
+template <typename String>
+typename std::enable_if<is_string_class<String>::value>::type
+minify(const String& source, basic_string_builder<char>& builder)
+{
+    builder.reserve(builder.size() + source.size());
+    detail::minify_runs(source.data(), source.size(),
+                        [&builder](const char* first, std::size_t size)
+                        {
+                            builder.write(first, size);
+                        });
+}
+
+} // namespace json
+} // namespace native
+
+#endif
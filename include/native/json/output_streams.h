@@ -0,0 +1,451 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_OUTPUT_STREAMS_H__
+#define NATIVE_JSON_OUTPUT_STREAMS_H__
+
+#include "native/config.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#include <unistd.h>
+#define NATIVE_JSON_FD_STREAM 1
+#endif
+
+namespace native
+{
+namespace json
+{
+
+// The streams here are what writer writes to. A stream has a char_type,
+// put(ch) to append one character and write(s, length) to append length
+// characters. basic_string_builder and std::ostream also work as streams.
+
+// Appends to a std::string.
+template <typename String = std::string>
+class string_stream
+{
+public:
+    using string_type = String;
+    using char_type = typename string_type::value_type;
+
+    string_stream(string_type& str)
+        : _str(str)
+    {
+    }
+
+    inline void put(char_type ch) { _str.push_back(ch); }
+
+    inline void write(const char_type* s, std::size_t length)
+    {
+        _str.append(s, length);
+    }
+
+    string_type& str() const { return _str; }
+
+private:
+    string_type& _str;
+};
+
+// Writes into a fixed buffer provided by the caller. Anything that doesn't fit
+// is dropped and overflow() returns true.
+class buffer_stream
+{
+public:
+    using char_type = char;
+
+    buffer_stream(char_type* buffer, std::size_t size)
+        : _first(buffer)
+        , _current(buffer)
+        , _last(buffer + size)
+        , _overflow(false)
+    {
+    }
+
+    inline void put(char_type ch)
+    {
+        if (_current != _last)
+        {
+            *_current++ = ch;
+        }
+        else
+        {
+            _overflow = true;
+        }
+    }
+
+    inline void write(const char_type* s, std::size_t length)
+    {
+        const auto available = static_cast<std::size_t>(_last - _current);
+        if (length > available)
+        {
+            length = available;
+            _overflow = true;
+        }
+        std::memcpy(_current, s, length);
+        _current += length;
+    }
+
+    const char_type* data() const { return _first; }
+
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(_current - _first);
+    }
+
+    // True if the output didn't fit.
+    bool overflow() const { return _overflow; }
+
+private:
+    char_type* _first;
+    char_type* _current;
+    char_type* _last;
+    bool _overflow;
+};
+
+// Feeds output to hasher.update(data, size) in blocks of BufferSize, so a
+// document can be hashed without keeping it. Call flush() before finishing
+// the hash; the destructor flushes too.
+template <typename Hasher, std::size_t BufferSize = 4096>
+class hash_stream
+{
+public:
+    using char_type = char;
+
+    explicit hash_stream(Hasher& hasher)
+        : _hasher(hasher)
+    {
+    }
+
+    hash_stream(const hash_stream&) = delete;
+    hash_stream& operator=(const hash_stream&) = delete;
+
+    ~hash_stream() { flush(); }
+
+    inline void put(char_type ch)
+    {
+        if (_size == BufferSize)
+        {
+            flush();
+        }
+        _buffer[_size++] = ch;
+    }
+
+    inline void write(const char_type* s, std::size_t length)
+    {
+        if (length > BufferSize - _size)
+        {
+            flush();
+            if (length >= BufferSize)
+            {
+                _hasher.update(s, length);
+                return;
+            }
+        }
+        std::memcpy(_buffer + _size, s, length);
+        _size += length;
+    }
+
+    void flush()
+    {
+        if (_size)
+        {
+            _hasher.update(_buffer, _size);
+            _size = 0;
+        }
+    }
+
+private:
+    Hasher& _hasher;
+    std::size_t _size = 0;
+    char_type _buffer[BufferSize];
+};
+
+#if defined(NATIVE_JSON_FD_STREAM)
+// Writes to a file descriptor through a large buffer. Call flush() when done
+// to see write errors; the destructor flushes too, but ignores them. The file
+// descriptor is not closed.
+class fd_stream
+{
+public:
+    using char_type = char;
+
+    static constexpr std::size_t default_buffer_size = 64 * 1024;
+
+    explicit fd_stream(int fd,
+                       std::size_t buffer_size = default_buffer_size)
+        : _fd(fd)
+        , _buffer(new char_type[buffer_size])
+        , _current(_buffer.get())
+        , _last(_buffer.get() + buffer_size)
+    {
+    }
+
+    fd_stream(const fd_stream&) = delete;
+    fd_stream& operator=(const fd_stream&) = delete;
+
+    ~fd_stream()
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    inline void put(char_type ch)
+    {
+        if (_current == _last)
+        {
+            flush();
+        }
+        *_current++ = ch;
+    }
+
+    inline void write(const char_type* s, std::size_t length)
+    {
+        if (length > static_cast<std::size_t>(_last - _current))
+        {
+            flush();
+            // too big to be worth buffering
+            if (length >= static_cast<std::size_t>(_last - _current))
+            {
+                _write(s, length);
+                return;
+            }
+        }
+        std::memcpy(_current, s, length);
+        _current += length;
+    }
+
+    // Write everything that is buffered. Throws std::system_error on failure.
+    void flush()
+    {
+        const auto length = static_cast<std::size_t>(_current - _buffer.get());
+        _current = _buffer.get();
+        _write(_buffer.get(), length);
+    }
+
+private:
+    void _write(const char_type* s, std::size_t length)
+    {
+        while (length)
+        {
+            const auto written = ::write(_fd, s, length);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(),
+                                        "write");
+            }
+            s += written;
+            length -= static_cast<std::size_t>(written);
+        }
+    }
+
+    int _fd;
+    std::unique_ptr<char_type[]> _buffer;
+    char_type* _current;
+    char_type* _last;
+};
+
+// Writes to a file descriptor with writev(). Output is copied into fixed size
+// blocks that are reused after every flush, and runs of at least
+// reference_size characters passed to write_reference() are not copied at
+// all: they are written from where they are, so they must outlive the next
+// flush(). writer::append_reference() passes strings this way, while
+// append() and keys are always copied.
+//
+// When every block is full the stream flushes, so memory use is bounded by
+// max_blocks * block_size.
+class iovec_stream
+{
+public:
+    using char_type = char;
+
+    static constexpr std::size_t default_block_size = 16 * 1024;
+    static constexpr std::size_t default_max_blocks = 16;
+
+    explicit iovec_stream(int fd,
+                          std::size_t block_size = default_block_size,
+                          std::size_t max_blocks = default_max_blocks,
+                          std::size_t reference_size = default_block_size / 4)
+        : _fd(fd)
+        , _block_size(block_size)
+        , _max_blocks(std::max<std::size_t>(max_blocks, 1))
+        , _reference_size(std::max<std::size_t>(reference_size, 1))
+    {
+    }
+
+    iovec_stream(const iovec_stream&) = delete;
+    iovec_stream& operator=(const iovec_stream&) = delete;
+
+    ~iovec_stream()
+    {
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    inline void put(char_type ch)
+    {
+        if (_current == _last)
+        {
+            _next_block();
+        }
+        *_current++ = ch;
+        ++_iovecs.back().iov_len;
+    }
+
+    inline void write(const char_type* s, std::size_t length)
+    {
+        while (length)
+        {
+            if (_current == _last)
+            {
+                _next_block();
+            }
+            const auto size = std::min(
+                length, static_cast<std::size_t>(_last - _current));
+            std::memcpy(_current, s, size);
+            _current += size;
+            _iovecs.back().iov_len += size;
+            s += size;
+            length -= size;
+        }
+    }
+
+    // Like write(), but large runs are referenced rather than copied.
+    inline void write_reference(const char_type* s, std::size_t length)
+    {
+        if (length < _reference_size)
+        {
+            write(s, length);
+            return;
+        }
+        _iovecs.push_back(iovec{const_cast<char_type*>(s), length});
+        _reference_bytes += length;
+        if (_reference_bytes >= _max_blocks * _block_size)
+        {
+            flush();
+        }
+        else if (_current != _last)
+        {
+            // the next copy starts a new iovec in the same block
+            _start_iovec();
+        }
+    }
+
+    // Write everything that is pending. Throws std::system_error on failure.
+    void flush()
+    {
+#if defined(IOV_MAX)
+        const std::size_t max_iovecs = IOV_MAX;
+#else
+        const std::size_t max_iovecs = 1024;
+#endif
+        auto* first = _iovecs.data();
+        auto* last = first + _iovecs.size();
+        while (first != last)
+        {
+            const auto count = std::min(
+                max_iovecs, static_cast<std::size_t>(last - first));
+            const auto result = ::writev(_fd, first, static_cast<int>(count));
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error(errno, std::system_category(),
+                                        "writev");
+            }
+
+            // skip what was written, then resume a partial iovec
+            auto written = static_cast<std::size_t>(result);
+            for (; first != last && written >= first->iov_len; ++first)
+            {
+                written -= first->iov_len;
+            }
+            if (first != last)
+            {
+                first->iov_base = static_cast<char*>(first->iov_base) + written;
+                first->iov_len -= written;
+            }
+        }
+
+        _iovecs.clear();
+        _reference_bytes = 0;
+        _used_blocks = 0;
+        _current = _last = nullptr;
+    }
+
+private:
+    void _next_block()
+    {
+        if (_used_blocks == _max_blocks)
+        {
+            flush();
+        }
+        if (_used_blocks == _blocks.size())
+        {
+            _blocks.emplace_back(new char_type[_block_size]);
+        }
+        _current = _blocks[_used_blocks++].get();
+        _last = _current + _block_size;
+        _start_iovec();
+    }
+
+    void _start_iovec()
+    {
+        _iovecs.push_back(iovec{_current, 0});
+    }
+
+    int _fd;
+    std::size_t _block_size;
+    std::size_t _max_blocks;
+    std::size_t _reference_size;
+    std::vector<std::unique_ptr<char_type[]>> _blocks;
+    std::size_t _used_blocks = 0;
+    std::vector<iovec> _iovecs;
+    std::size_t _reference_bytes = 0;
+    char_type* _current = nullptr;
+    char_type* _last = nullptr;
+};
+#endif
+
+} // namespace json
+} // namespace native
+
+#endif
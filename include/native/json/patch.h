@@ -0,0 +1,645 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_PATCH_H__
+#define NATIVE_JSON_PATCH_H__
+
+#include "native/config.h"
+
+#include "native/string_slice.h"
+
+#include "native/json/any.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace native
+{
+namespace json
+{
+
+// Thrown by patch() for an operation that is malformed or can't be applied,
+// including a test that fails.
+struct patch_error : std::runtime_error
+{
+    explicit patch_error(const std::string& message)
+        : std::runtime_error{"json patch: " + message}
+    {
+    }
+};
+
+// The value an RFC 6901 JSON Pointer refers to, or null if there isn't one.
+template <typename Any>
+const Any* resolve(const Any& value, const string_slice& pointer);
+
+// An RFC 6902 JSON Patch that turns from into to, as an array of operations.
+// Both values are hashed first, so unchanged subtrees are skipped with one
+// comparison and changed ones are found without walking the rest. The values
+// in the patch are shared with to.
+//
+// Elements of arrays are matched up before they are compared. In arrays of
+// objects that all have a member with a distinct string or integer, such as
+// an id, elements are matched by that member, and a changed element is
+// patched rather than replaced. Other elements are matched when they are
+// equal.
+template <typename Any>
+Any diff(const Any& from, const Any& to);
+
+// Applies an RFC 6902 JSON Patch. Either every operation is applied or, if
+// one fails, patch_error is thrown and value is left as it was. Only the
+// containers on the paths that change are copied.
+template <typename Any>
+void patch(Any& value, const Any& operations);
+
+namespace detail
+{
+
+// The reference tokens of a JSON Pointer, unescaped.
+inline std::vector<std::string> pointer_tokens(const string_slice& pointer)
+{
+    std::vector<std::string> tokens;
+    const auto* s = pointer.data();
+    const auto size = pointer.size();
+    if (size == 0)
+    {
+        return tokens;
+    }
+    if (s[0] != '/')
+    {
+        throw patch_error{"a pointer must start with /: " +
+                          std::string(s, size)};
+    }
+
+    std::string token;
+    for (std::size_t i = 1; i <= size; ++i)
+    {
+        if (i == size || s[i] == '/')
+        {
+            tokens.push_back(token);
+            token.clear();
+        }
+        else if (s[i] == '~')
+        {
+            if (++i == size || (s[i] != '0' && s[i] != '1'))
+            {
+                throw patch_error{"invalid escape in pointer: " +
+                                  std::string(s, size)};
+            }
+            token += s[i] == '0' ? '~' : '/';
+        }
+        else
+        {
+            token += s[i];
+        }
+    }
+    return tokens;
+}
+
+inline void append_token(std::string& pointer, const char* s, std::size_t size)
+{
+    pointer += '/';
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        switch (s[i])
+        {
+            case '~':
+                pointer += "~0";
+                break;
+            case '/':
+                pointer += "~1";
+                break;
+            default:
+                pointer += s[i];
+                break;
+        }
+    }
+}
+
+inline void append_token(std::string& pointer, std::size_t index)
+{
+    pointer += '/';
+    pointer += std::to_string(index);
+}
+
+// An array index in a pointer, which has no leading zeros. "-" is the end of
+// the array, size. Anything else is out of range.
+inline std::size_t pointer_index(const std::string& token, std::size_t size)
+{
+    const auto invalid = static_cast<std::size_t>(-1);
+    if (token == "-")
+    {
+        return size;
+    }
+    if (token.empty() || (token.size() > 1 && token[0] == '0'))
+    {
+        return invalid;
+    }
+
+    std::size_t result = 0;
+    for (const auto ch : token)
+    {
+        if (ch < '0' || ch > '9')
+        {
+            return invalid;
+        }
+        result = result * 10 + static_cast<std::size_t>(ch - '0');
+        if (result > size)
+        {
+            return invalid;
+        }
+    }
+    return result;
+}
+
+template <typename Any>
+const Any* member(const Any& object, const string_slice& key)
+{
+    const auto it = object.find(key);
+    return it == typename Any::object::const_iterator{} ? nullptr
+                                                         : &it->second;
+}
+
+template <typename Any>
+const Any& field(const Any& operation, const char* name)
+{
+    const auto* result = member(operation, name);
+    if (!result)
+    {
+        throw patch_error{std::string{"an operation has no "} + name};
+    }
+    return *result;
+}
+
+template <typename Any>
+std::string string_field(const Any& operation, const char* name)
+{
+    const auto& result = field(operation, name);
+    if (!result.is_string())
+    {
+        throw patch_error{std::string{name} + " must be a string"};
+    }
+    const auto value = result.string_value();
+    return std::string(value.data(), value.size());
+}
+
+// Members and elements are reached through the non-const accessors, so the
+// containers on the way down are copied if they are shared.
+template <typename Any>
+Any& child(Any& value, const std::string& token)
+{
+    if (value.is_object())
+    {
+        if (!member(value, token))
+        {
+            throw patch_error{"no member " + token};
+        }
+        return value[token];
+    }
+    if (value.is_array())
+    {
+        const auto index = pointer_index(token, value.size());
+        if (index >= value.size())
+        {
+            throw patch_error{"no element " + token};
+        }
+        return value[index];
+    }
+    throw patch_error{"a path goes into a scalar at " + token};
+}
+
+template <typename Any>
+Any& find_parent(Any& root, const std::vector<std::string>& tokens)
+{
+    auto* current = &root;
+    for (std::size_t i = 0; i + 1 < tokens.size(); ++i)
+    {
+        current = &child(*current, tokens[i]);
+    }
+    return *current;
+}
+
+template <typename Any>
+void apply_add(Any& root, const std::vector<std::string>& tokens, Any value)
+{
+    if (tokens.empty())
+    {
+        root = std::move(value);
+        return;
+    }
+
+    auto& parent = find_parent(root, tokens);
+    const auto& token = tokens.back();
+    if (parent.is_object())
+    {
+        parent[token] = std::move(value);
+    }
+    else if (parent.is_array())
+    {
+        const auto index = pointer_index(token, parent.size());
+        if (index > parent.size())
+        {
+            throw patch_error{"can't add element " + token};
+        }
+        parent.emplace(parent.begin() + index, std::move(value));
+    }
+    else
+    {
+        throw patch_error{"can't add " + token + " to a scalar"};
+    }
+}
+
+// Returns what was removed.
+template <typename Any>
+Any apply_remove(Any& root, const std::vector<std::string>& tokens)
+{
+    if (tokens.empty())
+    {
+        throw patch_error{"can't remove the whole document"};
+    }
+
+    auto& parent = find_parent(root, tokens);
+    const auto& token = tokens.back();
+    if (parent.is_object())
+    {
+        const auto* value = member(parent, token);
+        if (!value)
+        {
+            throw patch_error{"no member " + token};
+        }
+        auto result = value->share();
+        parent.erase(typename Any::string_type(token.data(), token.size()));
+        return result;
+    }
+    if (parent.is_array())
+    {
+        const auto index = pointer_index(token, parent.size());
+        if (index >= parent.size())
+        {
+            throw patch_error{"no element " + token};
+        }
+        auto it = parent.begin() + index;
+        auto result = it->share();
+        parent.erase(it);
+        return result;
+    }
+    throw patch_error{"can't remove " + token + " from a scalar"};
+}
+
+template <typename Any>
+void apply_replace(Any& root, const std::vector<std::string>& tokens,
+                   Any value)
+{
+    auto* target = &root;
+    for (const auto& token : tokens)
+    {
+        target = &child(*target, token);
+    }
+    *target = std::move(value);
+}
+
+template <typename Any>
+void apply(Any& root, const Any& operation)
+{
+    if (!operation.is_object())
+    {
+        throw patch_error{"an operation must be an object"};
+    }
+
+    const auto op = string_field(operation, "op");
+    const auto path = string_field(operation, "path");
+    const auto tokens = pointer_tokens(path);
+    if (op == "add")
+    {
+        apply_add(root, tokens, field(operation, "value").share());
+    }
+    else if (op == "remove")
+    {
+        apply_remove(root, tokens);
+    }
+    else if (op == "replace")
+    {
+        apply_replace(root, tokens, field(operation, "value").share());
+    }
+    else if (op == "move")
+    {
+        const auto from = string_field(operation, "from");
+        const auto from_tokens = pointer_tokens(from);
+        if (from_tokens == tokens)
+        {
+            return;
+        }
+        if (from_tokens.size() < tokens.size() &&
+            std::equal(from_tokens.begin(), from_tokens.end(), tokens.begin()))
+        {
+            throw patch_error{"can't move " + from + " into itself"};
+        }
+        apply_add(root, tokens, apply_remove(root, from_tokens));
+    }
+    else if (op == "copy")
+    {
+        const auto from = string_field(operation, "from");
+        const auto* value = resolve(static_cast<const Any&>(root), from);
+        if (!value)
+        {
+            throw patch_error{"nothing to copy at " + from};
+        }
+        apply_add(root, tokens, value->share());
+    }
+    else if (op == "test")
+    {
+        const auto* value = resolve(static_cast<const Any&>(root), path);
+        if (!value || *value != field(operation, "value"))
+        {
+            throw patch_error{"test failed at " + path};
+        }
+    }
+    else
+    {
+        throw patch_error{"unknown operation " + op};
+    }
+}
+
+template <typename Any>
+void append_operation(Any& operations, const char* op,
+                      const std::string& path, const Any* value)
+{
+    Any operation{json_object};
+    operation["op"] = op;
+    operation["path"] =
+        Any{typename Any::string_type(path.data(), path.size())};
+    if (value)
+    {
+        operation["value"] = value->share();
+    }
+    operations.emplace_back(std::move(operation));
+}
+
+// A member that every element of both arrays has, holding a string or an
+// integer that no other element of the same array has. The first element's
+// members are tried in turn.
+template <typename Any>
+const typename Any::string_type* array_key(const Any& from, const Any& to)
+{
+    if (from.empty() || to.empty() || !from.front().is_object())
+    {
+        return nullptr;
+    }
+
+    const auto distinct = [](const Any& elements,
+                             const string_slice& key) -> bool
+    {
+        std::unordered_set<std::size_t> seen;
+        for (const auto& element : elements)
+        {
+            if (!element.is_object())
+            {
+                return false;
+            }
+            const auto* value = member(element, key);
+            if (!value || !(value->is_string() || value->is_int()) ||
+                !seen.insert(value->hash()).second)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (const auto& item : from.front().items())
+    {
+        if ((item.second.is_string() || item.second.is_int()) &&
+            distinct(from, item.first) && distinct(to, item.first))
+        {
+            return &item.first;
+        }
+    }
+    return nullptr;
+}
+
+template <typename Any>
+void diff_values(Any& operations, const Any& from, const Any& to,
+                 std::string& path);
+
+template <typename Any>
+void diff_objects(Any& operations, const Any& from, const Any& to,
+                  std::string& path)
+{
+    const auto size = path.size();
+    for (const auto& item : from.items())
+    {
+        append_token(path, item.first.data(), item.first.size());
+        const auto* value = member(to, item.first);
+        if (value)
+        {
+            diff_values(operations, item.second, *value, path);
+        }
+        else
+        {
+            append_operation(operations, "remove", path,
+                             static_cast<const Any*>(nullptr));
+        }
+        path.resize(size);
+    }
+
+    for (const auto& item : to.items())
+    {
+        if (!member(from, item.first))
+        {
+            append_token(path, item.first.data(), item.first.size());
+            append_operation(operations, "add", path, &item.second);
+            path.resize(size);
+        }
+    }
+}
+
+// Walks both arrays at once, keeping index in step with the array as it is
+// being patched. Elements that are matched are diffed. An element that isn't
+// matched later in the other array is removed or added, or when both
+// aren't, the two are diffed. Otherwise the element of from has moved, and is
+// removed here and added where it's matched.
+template <typename Any>
+void diff_arrays(Any& operations, const Any& from, const Any& to,
+                 std::string& path)
+{
+    const auto* key = array_key(from, to);
+    const auto identity = [key](const Any& element)
+    {
+        return key ? member(element, *key)->hash() : element.hash();
+    };
+
+    std::vector<std::size_t> from_ids;
+    std::vector<std::size_t> to_ids;
+    std::unordered_map<std::size_t, std::size_t> from_pending;
+    std::unordered_map<std::size_t, std::size_t> to_pending;
+    from_ids.reserve(from.size());
+    to_ids.reserve(to.size());
+    for (const auto& element : from)
+    {
+        from_ids.push_back(identity(element));
+        ++from_pending[from_ids.back()];
+    }
+    for (const auto& element : to)
+    {
+        to_ids.push_back(identity(element));
+        ++to_pending[to_ids.back()];
+    }
+
+    const auto size = path.size();
+    std::size_t i = 0;
+    std::size_t j = 0;
+    std::size_t index = 0;
+    while (i < from_ids.size() && j < to_ids.size())
+    {
+        const auto from_later = to_pending[from_ids[i]] != 0;
+        const auto to_later = from_pending[to_ids[j]] != 0;
+        append_token(path, index);
+        if (from_ids[i] == to_ids[j] || (!from_later && !to_later))
+        {
+            diff_values(operations, from[i], to[j], path);
+            --from_pending[from_ids[i++]];
+            --to_pending[to_ids[j++]];
+            ++index;
+        }
+        else if (!to_later)
+        {
+            append_operation(operations, "add", path, &to[j]);
+            --to_pending[to_ids[j++]];
+            ++index;
+        }
+        else
+        {
+            append_operation(operations, "remove", path,
+                             static_cast<const Any*>(nullptr));
+            --from_pending[from_ids[i++]];
+        }
+        path.resize(size);
+    }
+
+    // from the back, so nothing is shifted
+    for (auto k = from_ids.size() - i; k-- > 0;)
+    {
+        append_token(path, index + k);
+        append_operation(operations, "remove", path,
+                         static_cast<const Any*>(nullptr));
+        path.resize(size);
+    }
+    for (; j < to_ids.size(); ++j, ++index)
+    {
+        append_token(path, index);
+        append_operation(operations, "add", path, &to[j]);
+        path.resize(size);
+    }
+}
+
+// Once both values are hashed, unequal containers compare in constant time.
+template <typename Any>
+void diff_values(Any& operations, const Any& from, const Any& to,
+                 std::string& path)
+{
+    if (from == to)
+    {
+        return;
+    }
+    if (from.type() == json_object && to.type() == json_object)
+    {
+        diff_objects(operations, from, to, path);
+    }
+    else if (from.type() == json_array && to.type() == json_array)
+    {
+        diff_arrays(operations, from, to, path);
+    }
+    else
+    {
+        append_operation(operations, "replace", path, &to);
+    }
+}
+
+} // namespace detail
+
+//
+// implementation
+//
+
+template <typename Any>
+const Any* resolve(const Any& value, const string_slice& pointer)
+{
+    const auto* current = &value;
+    for (const auto& token : detail::pointer_tokens(pointer))
+    {
+        if (current->is_object())
+        {
+            current = detail::member(*current, token);
+            if (!current)
+            {
+                return nullptr;
+            }
+        }
+        else if (current->is_array())
+        {
+            const auto index = detail::pointer_index(token, current->size());
+            if (index >= current->size())
+            {
+                return nullptr;
+            }
+            current = &(*current)[index];
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+    return current;
+}
+
+template <typename Any>
+Any diff(const Any& from, const Any& to)
+{
+    from.hash();
+    to.hash();
+
+    Any operations{json_array};
+    std::string path;
+    detail::diff_values(operations, from, to, path);
+    return operations;
+}
+
+// The operations are applied to a share of value, which replaces it once
+// they all have been.
+template <typename Any>
+void patch(Any& value, const Any& operations)
+{
+    if (!operations.is_array())
+    {
+        throw patch_error{"a patch must be an array"};
+    }
+
+    auto result = value.share();
+    for (const auto& operation : operations)
+    {
+        detail::apply(result, operation);
+    }
+    value = std::move(result);
+}
+
+} // namespace json
+} // namespace native
+
+#endif
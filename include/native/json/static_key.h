@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_STATIC_KEY_H__
+#define NATIVE_JSON_STATIC_KEY_H__
+
+#include "native/config.h"
+
+#include "native/hash.h"
+
+#include <cstddef>
+#include <type_traits>
+
+namespace native
+{
+namespace json
+{
+
+// An object key that has already been quoted and followed by a colon, so the
+// writer can emit it with one write. Make them with NATIVE_JSON_KEY.
+class static_key
+{
+public:
+    constexpr static_key(const char* data, std::size_t size)
+        : _data(data)
+        , _size(size)
+    {
+    }
+
+    // The quoted key and colon, e.g. "foo":
+    constexpr const char* data() const { return _data; }
+    constexpr std::size_t size() const { return _size; }
+
+private:
+    const char* _data;
+    std::size_t _size;
+};
+
+// An object key and its hash, for looking up members without hashing the
+// key again. The hash must be the one istring::hash() gives for the same
+// characters. Make them with NATIVE_JSON_HASHED_KEY, which hashes at compile
+// time.
+class hashed_key
+{
+public:
+    constexpr hashed_key(const char* data, std::size_t size, std::size_t hash)
+        : _data(data)
+        , _size(size)
+        , _hash(hash)
+    {
+    }
+
+    constexpr const char* data() const { return _data; }
+    constexpr std::size_t size() const { return _size; }
+    constexpr std::size_t hash() const { return _hash; }
+
+private:
+    const char* _data;
+    std::size_t _size;
+    std::size_t _hash;
+};
+
+namespace detail
+{
+
+// True if the key can be written without escaping. Non-ASCII characters are
+// excluded since they are escaped by default.
+constexpr bool is_plain_key(const char* key, std::size_t length)
+{
+    return length == 0 ||
+           (static_cast<unsigned char>(*key) >= 0x20 &&
+            static_cast<unsigned char>(*key) < 0x80 && *key != '"' &&
+            *key != '\\' && is_plain_key(key + 1, length - 1));
+}
+
+template <bool Plain>
+struct checked_key
+{
+    static_assert(Plain, "keys that need escaping can't be static keys");
+
+    static constexpr static_key make(const char* data, std::size_t size)
+    {
+        return static_key{data, size};
+    }
+};
+
+} // namespace detail
+
+} // namespace json
+} // namespace native
+
+// NATIVE_JSON_KEY("foo") is a static_key for "foo": checked at compile time.
+// name must be a string literal.
+#define NATIVE_JSON_KEY(name)                                                  \
+    ::native::json::detail::checked_key<::native::json::detail::is_plain_key(  \
+        name, sizeof(name) - 1)>::make("\"" name "\":", sizeof(name) + 2)
+
+// NATIVE_JSON_HASHED_KEY("foo") is a hashed_key for "foo", hashed at compile
+// time. name must be a string literal.
+#define NATIVE_JSON_HASHED_KEY(name)                                           \
+    ::native::json::hashed_key(                                                \
+        name, sizeof(name) - 1,                                                \
+        ::std::integral_constant<::std::size_t,                                \
+                                 ::native::default_hasher::static_hash(        \
+                                     name, sizeof(name) - 1)>::value)
+
+#endif
@@ -57,6 +57,23 @@ enum data_type : unsigned char
     type_float,
     type_double,
     type_long_double,
+    type_number, // the number's text, unconverted; see handler.h
+};
+
+// How basic_any::handler keeps numbers. number_lazy keeps the text of each
+// number parsed from JSON and converts it the first time it's read.
+enum number_mode : unsigned char
+{
+    number_convert,
+    number_lazy,
+};
+
+// how the writer handles non-ASCII characters in strings
+enum utf8_mode : unsigned char
+{
+    utf8_escape,   // write \uXXXX escapes
+    utf8_raw,      // copy UTF-8 through unchanged
+    utf8_validate, // copy UTF-8 through, but throw if it isn't well-formed
 };
 
 template <typename T>
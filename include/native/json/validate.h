@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_JSON_VALIDATE_H__
+#define NATIVE_JSON_VALIDATE_H__
+
+#include "native/config.h"
+
+#include "native/string_base.h"
+
+#include "native/json/detail/validate_impl.h"
+
+namespace native
+{
+namespace json
+{
+
+// Returns true if source is a well-formed JSON document. Like the parser, the
+// document must be an object or an array.
+//
+// This is much faster than parsing with an empty handler since strings are not
+// copied and numbers are not converted. Numbers are only checked against the
+// grammar, so an integer too big for 64 bits is still well-formed.
+//
+// If check_utf8 is true, the whole document must also be valid UTF-8. If
+// max_depth is not zero, then objects and arrays may not nest any deeper.
+inline bool validate(const char* source, std::size_t length,
+                     bool check_utf8 = false, std::size_t max_depth = 0)
+{
+    return detail::validator{source, length, check_utf8, max_depth}.validate();
+}
+
+template <typename String>
+typename std::enable_if<is_string_class<String>::value, bool>::type
+validate(const String& source, bool check_utf8 = false,
+         std::size_t max_depth = 0)
+{
+    return validate(source.data(), source.size(), check_utf8, max_depth);
+}
+
+} // namespace json
+} // namespace native
+
+#endif
@@ -22,10 +22,18 @@
 #include "native/istring.h"
 #include "native/utf.h"
 
+#include "native/detail/integers.h"
 #include "native/detail/range_istream.h"
+#include "native/detail/real.h"
 
 #include "native/json/conversion.h"
+#include "native/json/detail/inline_stack.h"
+#include "native/json/static_key.h"
+#include "native/json/types.h"
+#include "native/json/detail/scanner.h"
 
+#include <algorithm>
+#include <string>
 #include <type_traits>
 
 namespace native
@@ -33,11 +41,16 @@ namespace native
 namespace json
 {
 
-template <typename Stream>
+// Writes JSON to Stream. Nesting up to InlineDepth levels deep is tracked
+// without allocating.
+template <typename Stream, std::size_t InlineDepth = 32>
 class writer
 {
 public:
-    writer(Stream& ostr, std::size_t indent = 0);
+    // Non-ASCII characters in strings are written as \u escapes unless mode
+    // is utf8_raw or utf8_validate.
+    writer(Stream& ostr, std::size_t indent = 0,
+           utf8_mode mode = utf8_escape);
 
     void open_array();
     void close_array();
@@ -45,6 +58,16 @@ public:
     template <typename T>
     void append(T&& value);
 
+    // Like append() for a string, but with a stream that has
+    // write_reference(), like iovec_stream, long runs of value are written
+    // from where they are instead of being copied. value must outlive the
+    // stream's next flush().
+    template <typename T>
+    void append_reference(const T& value);
+
+    // A number's text, written as it is. It must already be valid JSON.
+    void append_number(const char* s, std::size_t length);
+
     void open_object();
     void close_object();
 
@@ -54,6 +77,11 @@ public:
     template <typename T, typename U>
     void append(T&& key, U&& value);
 
+    // Continue inside of an object or array that another writer opened depth
+    // levels deep, which already has elements if has_elements is true. This
+    // is how parts of one document are written separately.
+    void resume(bool object, std::size_t depth, bool has_elements);
+
 private:
     struct state
     {
@@ -62,139 +90,231 @@ private:
             array,
             object,
         } type;
-        bool has_elements = false;
-
-        state(t type)
-            : type{type}
-        {
-        }
+        bool has_elements;
     };
 
+    void _begin_value();
     void _comma();
     void _indent();
     void _close();
 
-    void _encode(const unsigned char* first, const unsigned char* last);
+    template <typename T>
+    void _write_key(const T& key);
+    void _write_key(const static_key& key);
+
+    void _encode(const unsigned char* first, const unsigned char* last,
+                 bool reference = false);
+    template <typename S>
+    static auto _write_run(S& ostr, const char* s, std::size_t length, int)
+        -> decltype(ostr.write_reference(s, length), void());
+    template <typename S>
+    static void _write_run(S& ostr, const char* s, std::size_t length, long);
     void _write(std::nullptr_t);
     void _write(bool value);
     void _write(const char* value);
     template <typename T>
-    typename std::enable_if<std::is_integral<T>::value ||
-                                std::is_floating_point<T>::value,
-                            void>::type
+    typename std::enable_if<std::is_integral<T>::value, void>::type
+    _write(T value);
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, void>::type
     _write(T value);
     template <typename T>
     typename std::enable_if<is_string_class<T>::value, void>::type
     _write(const T& value);
 
     Stream& _ostr;
-    istring _indent_string;
-    std::vector<state> _state;
+    std::size_t _indent_size;
+    std::string _newline; // a newline followed by indentation
+    utf8_mode _utf8_mode;
+    detail::inline_stack<state, InlineDepth> _state;
 };
 
-template <typename Stream>
-writer<Stream>::writer(Stream& ostr, std::size_t indent)
+template <typename Stream, std::size_t InlineDepth>
+writer<Stream, InlineDepth>::writer(Stream& ostr, std::size_t indent,
+                                    utf8_mode mode)
     : _ostr{ostr}
-    , _indent_string(indent, ' ')
+    , _indent_size{indent}
+    , _newline(indent ? 1 + indent * 8 : 1, ' ')
+    , _utf8_mode{mode}
 {
+    _newline[0] = '\n';
 }
 
-template <typename Stream>
-void writer<Stream>::open_array()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::open_array()
 {
+    _begin_value();
     _ostr.put('[');
-    _state.push_back(state::array);
+    _state.push_back(state{state::array, false});
 }
 
-template <typename Stream>
-void writer<Stream>::close_array()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::close_array()
 {
     _close();
 }
 
-template <typename Stream>
-void writer<Stream>::open_object()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::open_object()
 {
-    if (!_state.empty())
-    {
-        if (_state.back().type == state::array && _state.back().has_elements)
-        {
-            _comma();
-        }
-        _indent();
-    }
+    _begin_value();
     _ostr.put('{');
-    _state.push_back(state::object);
+    _state.push_back(state{state::object, false});
 }
 
-template <typename Stream>
-void writer<Stream>::close_object()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::close_object()
 {
     _close();
 }
 
-template <typename Stream>
+template <typename Stream, std::size_t InlineDepth>
 template <typename T>
-void writer<Stream>::key(T&& key)
+void writer<Stream, InlineDepth>::key(T&& key)
 {
     if (!_state.empty() && _state.back().has_elements)
     {
         _comma();
     }
     _indent();
-    _write(key);
-    _ostr.put(':');
-    if (!_indent_string.empty())
+    _write_key(key);
+    if (_indent_size)
     {
         _ostr.put(' ');
     }
 }
 
-template <typename Stream>
+template <typename Stream, std::size_t InlineDepth>
+template <typename T>
+void writer<Stream, InlineDepth>::_write_key(const T& key)
+{
+    _write(key);
+    _ostr.put(':');
+}
+
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_write_key(const static_key& key)
+{
+    _ostr.write(key.data(), key.size());
+}
+
+template <typename Stream, std::size_t InlineDepth>
 template <typename T, typename U>
-void writer<Stream>::append(T&& label, U&& value)
+void writer<Stream, InlineDepth>::append(T&& label, U&& value)
 {
     key(label);
     append(value);
 }
 
-template <typename Stream>
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::resume(bool object, std::size_t depth,
+                                         bool has_elements)
+{
+    // only the innermost state matters, the rest are for indentation
+    for (std::size_t i = 1; i < depth; ++i)
+    {
+        _state.push_back(state{state::array, true});
+    }
+    _state.push_back(
+        state{object ? state::object : state::array, has_elements});
+}
+
+template <typename Stream, std::size_t InlineDepth>
+template <typename T>
+void writer<Stream, InlineDepth>::append(T&& value)
+{
+    _begin_value();
+    _write(value);
+}
+
+template <typename Stream, std::size_t InlineDepth>
 template <typename T>
-void writer<Stream>::append(T&& value)
+void writer<Stream, InlineDepth>::append_reference(const T& value)
+{
+    _begin_value();
+    _encode(reinterpret_cast<const unsigned char*>(value.data()),
+            reinterpret_cast<const unsigned char*>(value.data()) + value.size(),
+            true);
+}
+
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::append_number(const char* s,
+                                                std::size_t length)
+{
+    _begin_value();
+    _ostr.write(s, length);
+}
+
+// Array elements are separated and indented here. In an object, key() has
+// already done that.
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_begin_value()
 {
-    if (!_state.empty())
+    if (_state.empty())
     {
-        if (_state.back().type == state::array)
+        return;
+    }
+
+    auto& current = _state.back();
+    if (current.type == state::array)
+    {
+        if (current.has_elements)
         {
-            if (_state.back().has_elements)
-            {
-                _comma();
-            }
-            _indent();
+            _comma();
         }
-
-        _state.back().has_elements = true;
+        _indent();
     }
-    _write(value);
+    current.has_elements = true;
+}
+
+template <typename Stream, std::size_t InlineDepth>
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, void>::type
+writer<Stream, InlineDepth>::_write(T value)
+{
+    ::native::detail::stream_append(_ostr, value);
 }
 
-template <typename Stream>
+// Shortest representation that reads back to the same value. Infinity and
+// NaN can't be represented in JSON, so they are written as null.
+template <typename Stream, std::size_t InlineDepth>
 template <typename T>
-typename std::enable_if<
-    std::is_integral<T>::value || std::is_floating_point<T>::value, void>::type
-writer<Stream>::_write(T value)
+typename std::enable_if<std::is_floating_point<T>::value, void>::type
+writer<Stream, InlineDepth>::_write(T value)
 {
-    _ostr << value;
+    using double_conversion::DoubleToStringConverter;
+    static const DoubleToStringConverter converter{
+        DoubleToStringConverter::NO_FLAGS,
+        nullptr, // infinity
+        nullptr, // NaN
+        'e',
+        ::native::detail::kConvMaxDecimalInShortestLow,
+        ::native::detail::kConvMaxDecimalInShortestHigh,
+        0,  // max leading padding zeros
+        0}; // max trailing padding zeros
+
+    char buffer[32];
+    double_conversion::StringBuilder builder{buffer, sizeof(buffer)};
+    const bool converted =
+        std::is_same<T, float>::value
+            ? converter.ToShortestSingle(static_cast<float>(value), &builder)
+            : converter.ToShortest(static_cast<double>(value), &builder);
+    if (!converted)
+    {
+        _write(nullptr);
+        return;
+    }
+    _ostr.write(buffer, builder.position());
 }
 
-template <typename Stream>
-void writer<Stream>::_write(std::nullptr_t)
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_write(std::nullptr_t)
 {
     _ostr.write("null", 4);
 }
 
-template <typename Stream>
-void writer<Stream>::_write(bool value)
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_write(bool value)
 {
     if (value)
     {
@@ -206,114 +326,180 @@ void writer<Stream>::_write(bool value)
     }
 }
 
-template <typename Stream>
-void writer<Stream>::_encode(const unsigned char* first,
-                             const unsigned char* last)
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_encode(const unsigned char* first,
+                                          const unsigned char* last,
+                                          bool reference)
 {
-    auto write_utf = [=](uint32_t codepoint)
+    struct escape
+    {
+        char text[7];
+        unsigned char length;
+    };
+
+    // clang-format off
+    static const escape control_escapes[0x20] = {
+        {"\\u0000", 6}, {"\\u0001", 6}, {"\\u0002", 6}, {"\\u0003", 6},
+        {"\\u0004", 6}, {"\\u0005", 6}, {"\\u0006", 6}, {"\\u0007", 6},
+        {"\\b", 2},     {"\\t", 2},     {"\\n", 2},     {"\\u000b", 6},
+        {"\\f", 2},     {"\\r", 2},     {"\\u000e", 6}, {"\\u000f", 6},
+        {"\\u0010", 6}, {"\\u0011", 6}, {"\\u0012", 6}, {"\\u0013", 6},
+        {"\\u0014", 6}, {"\\u0015", 6}, {"\\u0016", 6}, {"\\u0017", 6},
+        {"\\u0018", 6}, {"\\u0019", 6}, {"\\u001a", 6}, {"\\u001b", 6},
+        {"\\u001c", 6}, {"\\u001d", 6}, {"\\u001e", 6}, {"\\u001f", 6},
+    };
+    // clang-format on
+
+    auto write_utf = [](char* out, uint32_t codepoint)
+    {
+        static const char hex_digits[] = "0123456789abcdef";
+        out[0] = '\\';
+        out[1] = 'u';
+        out[2] = hex_digits[codepoint >> 0xC];
+        out[3] = hex_digits[(codepoint >> 0x8) & 0x0f];
+        out[4] = hex_digits[(codepoint >> 0x4) & 0x0f];
+        out[5] = hex_digits[codepoint & 0x0f];
+    };
+
+    // copy runs of characters that don't need escaping with one write
+    const auto* run = first;
+    const auto flush = [&]()
     {
-        auto hex_digit = [](uint32_t ch) -> char
+        const auto length = static_cast<std::size_t>(first - run);
+        if (length && reference)
+        {
+            _write_run(_ostr, reinterpret_cast<const char*>(run), length, 0);
+        }
+        else if (length)
         {
-            return ch < 10 ? ch + '0' : ch - 10 + 'a';
-        };
-
-        _ostr.put('\\');
-        _ostr.put('u');
-        _ostr.put(hex_digit(codepoint >> 0xC));
-        _ostr.put(hex_digit((codepoint >> 0x8) & 0x0f));
-        _ostr.put(hex_digit((codepoint >> 0x4) & 0x0f));
-        _ostr.put(hex_digit(codepoint & 0x0f));
+            _ostr.write(reinterpret_cast<const char*>(run), length);
+        }
     };
 
-    ::native::detail::range_istream<const unsigned char*> istr{first, last};
     _ostr.put('"');
-    for (; istr;)
+    while (first < last)
     {
-        if (istr.peek() & 0x80)
+        first = reinterpret_cast<const unsigned char*>(detail::find_escape(
+            reinterpret_cast<const char*>(first),
+            reinterpret_cast<const char*>(last), _utf8_mode != utf8_raw));
+        if (first == last)
+        {
+            break;
+        }
+
+        if (*first & 0x80 && _utf8_mode == utf8_validate)
+        {
+            const auto* next = utf8::validate_sequence(
+                reinterpret_cast<const char*>(first),
+                reinterpret_cast<const char*>(last));
+            if (!next)
+            {
+                throw std::runtime_error("invalid utf-8 sequence");
+            }
+            first = reinterpret_cast<const unsigned char*>(next);
+            continue;
+        }
+
+        flush();
+        if (*first < 0x20)
+        {
+            const auto& escaped = control_escapes[*first];
+            _ostr.write(escaped.text, escaped.length);
+            ++first;
+        }
+        else if (*first & 0x80)
         {
-            uint32_t codepoint = utf8::decode(istr);
+            ::native::detail::range_istream<const unsigned char*> istr{first,
+                                                                       last};
+            const uint32_t codepoint = utf8::decode(istr);
+            first += istr.tellg();
+
+            char buffer[12];
             if (codepoint & 0xFFFF0000)
             {
-                write_utf((codepoint >> 10) + 0xD7C0);
-                write_utf((codepoint & 0x3FF) + 0xDC00);
+                write_utf(buffer, (codepoint >> 10) + 0xD7C0);
+                write_utf(buffer + 6, (codepoint & 0x3FF) + 0xDC00);
+                _ostr.write(buffer, 12);
             }
             else
             {
-                write_utf(codepoint);
+                write_utf(buffer, codepoint);
+                _ostr.write(buffer, 6);
             }
         }
         else
         {
-            switch (istr.peek())
-            {
-                case '\b':
-                    _ostr.write("\\b", 2);
-                    break;
-                case '\f':
-                    _ostr.write("\\f", 2);
-                    break;
-                case '\n':
-                    _ostr.write("\\n", 2);
-                    break;
-                case '\r':
-                    _ostr.write("\\r", 2);
-                    break;
-                case '\t':
-                    _ostr.write("\\t", 2);
-                    break;
-                // case '/': // unnecessary & ugly :/
-                case '\\':
-                case '"':
-                    _ostr.put('\\');
-                default:
-                    _ostr.put(istr.peek());
-                    break;
-            }
-            istr.next();
+            // case '/': // unnecessary & ugly :/
+            const char escaped[2] = {'\\', static_cast<char>(*first)};
+            _ostr.write(escaped, 2);
+            ++first;
         }
+        run = first;
     }
+    flush();
     _ostr.put('"');
 }
 
-template <typename Stream>
-void writer<Stream>::_write(const char* value)
+// Streams that can reference large runs of a string instead of copying them
+// (like iovec_stream) provide write_reference(). It's only used for strings
+// given to append_reference().
+template <typename Stream, std::size_t InlineDepth>
+template <typename S>
+auto writer<Stream, InlineDepth>::_write_run(S& ostr, const char* s,
+                                             std::size_t length, int)
+    -> decltype(ostr.write_reference(s, length), void())
+{
+    ostr.write_reference(s, length);
+}
+
+template <typename Stream, std::size_t InlineDepth>
+template <typename S>
+void writer<Stream, InlineDepth>::_write_run(S& ostr, const char* s,
+                                             std::size_t length, long)
+{
+    ostr.write(s, length);
+}
+
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_write(const char* value)
 {
     _encode(reinterpret_cast<const unsigned char*>(value),
             reinterpret_cast<const unsigned char*>(value) + std::strlen(value));
 }
 
-template <typename Stream>
+template <typename Stream, std::size_t InlineDepth>
 template <typename T>
 typename std::enable_if<is_string_class<T>::value, void>::type
-writer<Stream>::_write(const T& value)
+writer<Stream, InlineDepth>::_write(const T& value)
 {
     _encode(reinterpret_cast<const unsigned char*>(value.data()),
             reinterpret_cast<const unsigned char*>(value.data()) +
                 value.size());
 }
 
-template <typename Stream>
-void writer<Stream>::_comma()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_comma()
 {
     _ostr.put(',');
 }
 
-template <typename Stream>
-void writer<Stream>::_indent()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_indent()
 {
-    if (_indent_string.empty())
+    if (!_indent_size)
     {
         return;
     }
-    _ostr.put('\n');
-    for (size_t i = 0; i < _state.size(); ++i)
+    const auto length = 1 + _state.size() * _indent_size;
+    if (length > _newline.size())
     {
-        _ostr.write(_indent_string.data(), _indent_string.size());
+        _newline.resize(std::max(length, _newline.size() * 2), ' ');
     }
+    _ostr.write(_newline.data(), length);
 }
 
-template <typename Stream>
-void writer<Stream>::_close()
+template <typename Stream, std::size_t InlineDepth>
+void writer<Stream, InlineDepth>::_close()
 {
     if (_state.empty())
     {
@@ -335,10 +521,6 @@ void writer<Stream>::_close()
             _ostr.put('}');
             break;
     }
-    if (!_state.empty() && _state.back().type == state::object)
-    {
-        _state.back().has_elements = true;
-    }
 }
 
 } // namespace json
@@ -0,0 +1,333 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_MSGPACK_PARSER_IMPL_H__
+#define NATIVE_MSGPACK_PARSER_IMPL_H__
+
+#include "native/config.h"
+
+#include "native/detail/big_endian.h"
+#include "native/detail/typed_value.h"
+#include "native/json/types.h"
+#include "native/msgpack/exceptions.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace native
+{
+namespace msgpack
+{
+namespace detail
+{
+
+// what typed_integer() and typed_real() throw for this parser
+struct number_errors
+{
+    using number_too_big_for_expected_type =
+        msgpack::number_too_big_for_expected_type;
+    using unexpected_signed_value = msgpack::unexpected_signed_value;
+    using unexpected_decimal_value = msgpack::unexpected_decimal_value;
+};
+
+// Calls the handler the way json::detail::parser_impl does: strings and keys
+// are null terminated copies, key() and start_array() return the expected
+// type of what follows, and numbers are converted to it. bin is passed to
+// value() like str.
+template <typename Handler>
+class parser_impl
+{
+public:
+    using handler_type = Handler;
+    using char_type = typename handler_type::char_type;
+    using buffer_type = std::vector<char_type>;
+
+    static_assert(sizeof(char_type) == 1, "MessagePack strings are UTF-8");
+
+    parser_impl(const unsigned char* first, const unsigned char* last,
+                handler_type& handler, std::size_t max_depth)
+        : first(first)
+        , current(first)
+        , last(last)
+        , handler(handler)
+        , max_depth(max_depth)
+    {
+    }
+
+    // parse one value
+    void parse() { parse_value(json::type_unknown, 0); }
+
+    // parse one value and check that nothing follows it
+    void parse_whole()
+    {
+        parse();
+        if (current != last)
+        {
+            throw expected_end_of_input(offset());
+        }
+    }
+
+    std::size_t offset() const
+    {
+        return static_cast<std::size_t>(current - first);
+    }
+
+    void need(std::size_t size)
+    {
+        if (static_cast<std::size_t>(last - current) < size)
+        {
+            throw unexpected_end_of_input(offset());
+        }
+    }
+
+    template <typename T>
+    T read()
+    {
+        need(sizeof(T));
+        const auto value = ::native::detail::load_big_endian<T>(current);
+        current += sizeof(T);
+        return value;
+    }
+
+    void parse_value(json::data_type expected_type, std::size_t depth)
+    {
+        const auto type = read<std::uint8_t>();
+        if (type < 0x80) // positive fixint
+        {
+            parse_integer(std::uint64_t{type}, expected_type);
+            return;
+        }
+        if (type >= 0xe0) // negative fixint
+        {
+            parse_integer(std::int64_t{static_cast<signed char>(type)},
+                          expected_type);
+            return;
+        }
+        switch (type & 0xf0)
+        {
+            case 0x80:
+                parse_map(type & 0x0f, depth);
+                return;
+            case 0x90:
+                parse_array(type & 0x0f, depth);
+                return;
+            case 0xa0:
+            case 0xb0:
+                parse_string(type & 0x1f, string_buffer);
+                handler.value(&string_buffer[0], string_buffer.size() - 1);
+                return;
+        }
+
+        switch (type)
+        {
+            case 0xc0:
+                handler.value(nullptr);
+                return;
+            case 0xc2:
+                handler.value(false);
+                return;
+            case 0xc3:
+                handler.value(true);
+                return;
+            case 0xc4:
+            case 0xd9:
+                parse_string(read<std::uint8_t>(), string_buffer);
+                break;
+            case 0xc5:
+            case 0xda:
+                parse_string(read<std::uint16_t>(), string_buffer);
+                break;
+            case 0xc6:
+            case 0xdb:
+                parse_string(read<std::uint32_t>(), string_buffer);
+                break;
+            case 0xca:
+                parse_real(::native::detail::float_from_bits(
+                               read<std::uint32_t>()),
+                           expected_type);
+                return;
+            case 0xcb:
+                parse_real(::native::detail::double_from_bits(
+                               read<std::uint64_t>()),
+                           expected_type);
+                return;
+            case 0xcc:
+                parse_integer(std::uint64_t{read<std::uint8_t>()},
+                              expected_type);
+                return;
+            case 0xcd:
+                parse_integer(std::uint64_t{read<std::uint16_t>()},
+                              expected_type);
+                return;
+            case 0xce:
+                parse_integer(std::uint64_t{read<std::uint32_t>()},
+                              expected_type);
+                return;
+            case 0xcf:
+                parse_integer(read<std::uint64_t>(), expected_type);
+                return;
+            case 0xd0:
+                parse_signed(static_cast<std::int8_t>(read<std::uint8_t>()),
+                             expected_type);
+                return;
+            case 0xd1:
+                parse_signed(static_cast<std::int16_t>(read<std::uint16_t>()),
+                             expected_type);
+                return;
+            case 0xd2:
+                parse_signed(static_cast<std::int32_t>(read<std::uint32_t>()),
+                             expected_type);
+                return;
+            case 0xd3:
+                parse_signed(static_cast<std::int64_t>(read<std::uint64_t>()),
+                             expected_type);
+                return;
+            case 0xdc:
+                parse_array(read<std::uint16_t>(), depth);
+                return;
+            case 0xdd:
+                parse_array(read<std::uint32_t>(), depth);
+                return;
+            case 0xde:
+                parse_map(read<std::uint16_t>(), depth);
+                return;
+            case 0xdf:
+                parse_map(read<std::uint32_t>(), depth);
+                return;
+            case 0xc7:
+            case 0xc8:
+            case 0xc9:
+            case 0xd4:
+            case 0xd5:
+            case 0xd6:
+            case 0xd7:
+            case 0xd8:
+                throw unsupported_extension(offset() - 1);
+            default:
+                throw invalid_type(offset() - 1);
+        }
+
+        // bin and the longer strs
+        handler.value(&string_buffer[0], string_buffer.size() - 1);
+    }
+
+    void parse_string(std::size_t size, buffer_type& buffer)
+    {
+        need(size);
+        buffer.assign(current, current + size);
+        buffer.push_back(0);
+        current += size;
+    }
+
+    void parse_key()
+    {
+        const auto type = read<std::uint8_t>();
+        if ((type & 0xe0) == 0xa0)
+        {
+            parse_string(type & 0x1f, key_buffer);
+            return;
+        }
+        switch (type)
+        {
+            case 0xd9:
+                parse_string(read<std::uint8_t>(), key_buffer);
+                break;
+            case 0xda:
+                parse_string(read<std::uint16_t>(), key_buffer);
+                break;
+            case 0xdb:
+                parse_string(read<std::uint32_t>(), key_buffer);
+                break;
+            default:
+                throw expected_string_key(offset() - 1);
+        }
+    }
+
+    // Sizes aren't trusted for reserving anything, so a bad one just runs
+    // into the end of the input.
+    void parse_array(std::size_t size, std::size_t depth)
+    {
+        if (depth == max_depth)
+        {
+            throw nesting_too_deep(offset());
+        }
+
+        const auto expected_type = handler.start_array();
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            parse_value(expected_type, depth + 1);
+        }
+        handler.end_array();
+    }
+
+    void parse_map(std::size_t size, std::size_t depth)
+    {
+        if (depth == max_depth)
+        {
+            throw nesting_too_deep(offset());
+        }
+
+        handler.start_object();
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            parse_key();
+            const auto expected_type =
+                handler.key(&key_buffer[0], key_buffer.size() - 1);
+            parse_value(expected_type, depth + 1);
+        }
+        handler.end_object();
+    }
+
+    void parse_signed(std::int64_t value, json::data_type expected_type)
+    {
+        if (value < 0)
+        {
+            parse_integer(value, expected_type);
+        }
+        else
+        {
+            parse_integer(static_cast<std::uint64_t>(value), expected_type);
+        }
+    }
+
+    // value is a std::uint64_t, or a negative std::int64_t
+    template <typename T>
+    void parse_integer(T value, json::data_type expected_type)
+    {
+        ::native::detail::typed_integer<number_errors>(handler, value,
+                                                       expected_type, offset());
+    }
+
+    void parse_real(double value, json::data_type expected_type)
+    {
+        ::native::detail::typed_real<number_errors>(handler, value,
+                                                    expected_type, offset());
+    }
+
+    const unsigned char* first;
+    const unsigned char* current;
+    const unsigned char* last;
+    handler_type& handler;
+    std::size_t max_depth;
+    buffer_type key_buffer;
+    buffer_type string_buffer;
+};
+
+} // namespace detail
+} // namespace msgpack
+} // namespace native
+
+#endif
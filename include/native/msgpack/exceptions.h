@@ -0,0 +1,57 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_MSGPACK_EXCEPTIONS_H__
+#define NATIVE_MSGPACK_EXCEPTIONS_H__
+
+#include "native/config.h"
+
+#include "native/detail/offset_exception.h"
+
+namespace native
+{
+namespace msgpack
+{
+
+struct msgpack_exception : public ::native::detail::offset_exception
+{
+    using offset_exception::offset_exception;
+};
+
+#define NATIVE_MSGPACK_EXCEPTION_DECL(className, messageText)                  \
+    NATIVE_OFFSET_EXCEPTION_DECL(msgpack_exception, className, messageText)
+
+NATIVE_MSGPACK_EXCEPTION_DECL(unexpected_end_of_input,
+                              "Unexpected end of input")
+NATIVE_MSGPACK_EXCEPTION_DECL(expected_end_of_input, "Expected end of input")
+NATIVE_MSGPACK_EXCEPTION_DECL(invalid_type, "Invalid type")
+NATIVE_MSGPACK_EXCEPTION_DECL(unsupported_extension,
+                              "Extension types are not supported")
+NATIVE_MSGPACK_EXCEPTION_DECL(expected_string_key, "Expected string key")
+NATIVE_MSGPACK_EXCEPTION_DECL(nesting_too_deep, "Nesting too deep")
+NATIVE_MSGPACK_EXCEPTION_DECL(
+    unexpected_signed_value,
+    "The number given was signed when only unsigned was expected")
+NATIVE_MSGPACK_EXCEPTION_DECL(
+    number_too_big_for_expected_type,
+    "The number given was too big for the expected type")
+NATIVE_MSGPACK_EXCEPTION_DECL(
+    unexpected_decimal_value,
+    "The number given was a decimal instead of an integer")
+}
+} // namespace native::msgpack
+
+#endif
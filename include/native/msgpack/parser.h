@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_MSGPACK_PARSER_H__
+#define NATIVE_MSGPACK_PARSER_H__
+
+#include "native/config.h"
+
+#include "native/detail/binary_parser.h"
+#include "native/msgpack/detail/parser_impl.h"
+
+namespace native
+{
+namespace msgpack
+{
+
+// Parses MessagePack into the same handlers as json::parser (see
+// native/json/handler.h), so switching a hop from JSON to MessagePack only
+// changes the parser. Map keys must be strings and extension types aren't
+// supported.
+//
+// See native/msgpack/exceptions.h for the exceptions that are thrown.
+class parser : public ::native::detail::binary_parser<detail::parser_impl>
+{
+public:
+    using binary_parser::binary_parser;
+};
+
+} // namespace msgpack
+} // namespace native
+
+#endif
@@ -0,0 +1,473 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef NATIVE_MSGPACK_WRITER_H__
+#define NATIVE_MSGPACK_WRITER_H__
+
+#include "native/config.h"
+
+#include "native/string_base.h"
+
+#include "native/detail/big_endian.h"
+#include "native/json/detail/inline_stack.h"
+#include "native/json/static_key.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace native
+{
+namespace msgpack
+{
+
+// Writes MessagePack to Stream with the same methods as json::writer, so the
+// two can be swapped. MessagePack puts the size of an array or map before its
+// elements; when open_array() or open_object() are given the size, elements
+// are written straight to the stream. Otherwise everything up to the end of
+// the outermost unsized container is buffered, and the sizes are filled in
+// when it is closed.
+template <typename Stream>
+class writer
+{
+public:
+    explicit writer(Stream& ostr);
+
+    void open_array();
+    void open_array(std::size_t size);
+    void close_array();
+
+    template <typename T>
+    void append(T&& value);
+
+    void open_object();
+    void open_object(std::size_t size);
+    void close_object();
+
+    template <typename T>
+    void key(T&& key);
+
+    template <typename T, typename U>
+    void append(T&& key, U&& value);
+
+private:
+    struct state
+    {
+        bool object;
+        bool sized;
+        std::size_t header; // into _headers, when not sized
+    };
+
+    // A container size that goes at position in the buffer.
+    struct header
+    {
+        std::size_t position;
+        std::size_t size;
+        bool object;
+    };
+
+    void _begin_value();
+    void _open(bool object);
+    void _open(bool object, std::size_t size);
+    void _close();
+    void _flush_buffer();
+
+    void _put(unsigned char ch);
+    void _write_bytes(const void* s, std::size_t length);
+    template <typename T>
+    void _write_big_endian(unsigned char type, T value);
+    void _write_size(std::size_t size, unsigned char fix, std::size_t fix_max,
+                     unsigned char type8, unsigned char type16,
+                     unsigned char type32);
+    void _write_container(bool object, std::size_t size);
+
+    void _write_key(const json::static_key& key);
+    template <typename T>
+    void _write_key(const T& key);
+
+    void _write(std::nullptr_t);
+    void _write(bool value);
+    void _write(const char* value);
+    void _write_string(const char* s, std::size_t length);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value &&
+                                std::is_signed<T>::value,
+                            void>::type
+    _write(T value);
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value &&
+                                !std::is_signed<T>::value,
+                            void>::type
+    _write(T value);
+    void _write(float value);
+    void _write(double value);
+    void _write(long double value);
+    template <typename T>
+    typename std::enable_if<is_string_class<T>::value, void>::type
+    _write(const T& value);
+
+    Stream& _ostr;
+    json::detail::inline_stack<state, 32> _state;
+    std::size_t _unsized_depth = 0;
+    std::string _buffer;
+    std::vector<header> _headers;
+};
+
+template <typename Stream>
+writer<Stream>::writer(Stream& ostr)
+    : _ostr(ostr)
+{
+}
+
+template <typename Stream>
+void writer<Stream>::open_array()
+{
+    _open(false);
+}
+
+template <typename Stream>
+void writer<Stream>::open_array(std::size_t size)
+{
+    _open(false, size);
+}
+
+template <typename Stream>
+void writer<Stream>::close_array()
+{
+    _close();
+}
+
+template <typename Stream>
+void writer<Stream>::open_object()
+{
+    _open(true);
+}
+
+template <typename Stream>
+void writer<Stream>::open_object(std::size_t size)
+{
+    _open(true, size);
+}
+
+template <typename Stream>
+void writer<Stream>::close_object()
+{
+    _close();
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::append(T&& value)
+{
+    _begin_value();
+    _write(value);
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::key(T&& key)
+{
+    const auto& current = _state.back();
+    if (!current.sized)
+    {
+        ++_headers[current.header].size;
+    }
+    _write_key(key);
+}
+
+template <typename Stream>
+template <typename T, typename U>
+void writer<Stream>::append(T&& label, U&& value)
+{
+    key(label);
+    append(value);
+}
+
+// Values in maps are counted by their keys.
+template <typename Stream>
+void writer<Stream>::_begin_value()
+{
+    if (_state.empty())
+    {
+        return;
+    }
+
+    const auto& current = _state.back();
+    if (!current.object && !current.sized)
+    {
+        ++_headers[current.header].size;
+    }
+}
+
+template <typename Stream>
+void writer<Stream>::_open(bool object)
+{
+    _begin_value();
+    _state.push_back(state{object, false, _headers.size()});
+    _headers.push_back(header{_buffer.size(), 0, object});
+    ++_unsized_depth;
+}
+
+template <typename Stream>
+void writer<Stream>::_open(bool object, std::size_t size)
+{
+    _begin_value();
+    _write_container(object, size);
+    _state.push_back(state{object, true, 0});
+}
+
+template <typename Stream>
+void writer<Stream>::_close()
+{
+    if (_state.empty())
+    {
+        return;
+    }
+
+    const auto current = _state.back();
+    _state.pop_back();
+    if (!current.sized && --_unsized_depth == 0)
+    {
+        _flush_buffer();
+    }
+}
+
+// Write the buffer with the headers put in, now that their sizes are known.
+template <typename Stream>
+void writer<Stream>::_flush_buffer()
+{
+    std::size_t position = 0;
+    for (const auto& item : _headers)
+    {
+        _ostr.write(_buffer.data() + position, item.position - position);
+        _write_container(item.object, item.size);
+        position = item.position;
+    }
+    _ostr.write(_buffer.data() + position, _buffer.size() - position);
+
+    _buffer.clear();
+    _headers.clear();
+}
+
+template <typename Stream>
+inline void writer<Stream>::_put(unsigned char ch)
+{
+    if (_unsized_depth)
+    {
+        _buffer.push_back(static_cast<char>(ch));
+    }
+    else
+    {
+        _ostr.put(static_cast<char>(ch));
+    }
+}
+
+template <typename Stream>
+inline void writer<Stream>::_write_bytes(const void* s, std::size_t length)
+{
+    const auto* data = static_cast<const char*>(s);
+    if (_unsized_depth)
+    {
+        _buffer.append(data, length);
+    }
+    else
+    {
+        _ostr.write(data, length);
+    }
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::_write_big_endian(unsigned char type, T value)
+{
+    unsigned char buffer[1 + sizeof(T)];
+    buffer[0] = type;
+    ::native::detail::store_big_endian(value, buffer + 1);
+    _write_bytes(buffer, sizeof(buffer));
+}
+
+template <typename Stream>
+void writer<Stream>::_write_size(std::size_t size, unsigned char fix,
+                                 std::size_t fix_max, unsigned char type8,
+                                 unsigned char type16, unsigned char type32)
+{
+    if (size <= fix_max)
+    {
+        _put(static_cast<unsigned char>(fix | size));
+    }
+    else if (type8 && size <= 0xff)
+    {
+        _write_big_endian(type8, static_cast<std::uint8_t>(size));
+    }
+    else if (size <= 0xffff)
+    {
+        _write_big_endian(type16, static_cast<std::uint16_t>(size));
+    }
+    else
+    {
+        _write_big_endian(type32, static_cast<std::uint32_t>(size));
+    }
+}
+
+template <typename Stream>
+void writer<Stream>::_write_container(bool object, std::size_t size)
+{
+    if (object)
+    {
+        _write_size(size, 0x80, 15, 0, 0xde, 0xdf);
+    }
+    else
+    {
+        _write_size(size, 0x90, 15, 0, 0xdc, 0xdd);
+    }
+}
+
+// Static keys are quoted and followed by a colon for JSON.
+template <typename Stream>
+void writer<Stream>::_write_key(const json::static_key& key)
+{
+    _write_string(key.data() + 1, key.size() - 3);
+}
+
+template <typename Stream>
+template <typename T>
+void writer<Stream>::_write_key(const T& key)
+{
+    _write(key);
+}
+
+template <typename Stream>
+void writer<Stream>::_write(std::nullptr_t)
+{
+    _put(0xc0);
+}
+
+template <typename Stream>
+void writer<Stream>::_write(bool value)
+{
+    _put(value ? 0xc3 : 0xc2);
+}
+
+template <typename Stream>
+void writer<Stream>::_write(const char* value)
+{
+    _write_string(value, std::strlen(value));
+}
+
+template <typename Stream>
+template <typename T>
+typename std::enable_if<is_string_class<T>::value, void>::type
+writer<Stream>::_write(const T& value)
+{
+    _write_string(value.data(), value.size());
+}
+
+template <typename Stream>
+void writer<Stream>::_write_string(const char* s, std::size_t length)
+{
+    _write_size(length, 0xa0, 31, 0xd9, 0xda, 0xdb);
+    _write_bytes(s, length);
+}
+
+// The smallest encoding that holds the value.
+template <typename Stream>
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                            !std::is_signed<T>::value,
+                        void>::type
+writer<Stream>::_write(T value)
+{
+    const auto number = static_cast<std::uint64_t>(value);
+    if (number < 0x80)
+    {
+        _put(static_cast<unsigned char>(number));
+    }
+    else if (number <= 0xff)
+    {
+        _write_big_endian(0xcc, static_cast<std::uint8_t>(number));
+    }
+    else if (number <= 0xffff)
+    {
+        _write_big_endian(0xcd, static_cast<std::uint16_t>(number));
+    }
+    else if (number <= 0xffffffff)
+    {
+        _write_big_endian(0xce, static_cast<std::uint32_t>(number));
+    }
+    else
+    {
+        _write_big_endian(0xcf, number);
+    }
+}
+
+template <typename Stream>
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                            std::is_signed<T>::value,
+                        void>::type
+writer<Stream>::_write(T value)
+{
+    const auto number = static_cast<std::int64_t>(value);
+    if (number >= 0)
+    {
+        _write(static_cast<std::uint64_t>(number));
+    }
+    else if (number >= -32)
+    {
+        _put(static_cast<unsigned char>(number));
+    }
+    else if (number >= -0x80)
+    {
+        _write_big_endian(0xd0, static_cast<std::uint8_t>(number));
+    }
+    else if (number >= -0x8000)
+    {
+        _write_big_endian(0xd1, static_cast<std::uint16_t>(number));
+    }
+    else if (number >= -0x7fffffffLL - 1)
+    {
+        _write_big_endian(0xd2, static_cast<std::uint32_t>(number));
+    }
+    else
+    {
+        _write_big_endian(0xd3, static_cast<std::uint64_t>(number));
+    }
+}
+
+template <typename Stream>
+void writer<Stream>::_write(float value)
+{
+    _write_big_endian(0xca, ::native::detail::float_bits(value));
+}
+
+template <typename Stream>
+void writer<Stream>::_write(double value)
+{
+    _write_big_endian(0xcb, ::native::detail::double_bits(value));
+}
+
+template <typename Stream>
+void writer<Stream>::_write(long double value)
+{
+    _write(static_cast<double>(value));
+}
+
+} // namespace msgpack
+} // namespace native
+
+#endif
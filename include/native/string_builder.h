@@ -27,6 +27,8 @@
 
 #include "native/istring.h"
 
+#include <algorithm>
+
 namespace native
 {
 
@@ -592,6 +594,11 @@ basic_string_builder<Ch>& basic_string_builder<Ch>::write(const_pointer s,
                                                           size_type length)
 {
     const auto size = _core.size();
+    if (_core.data() && size + length > _core.capacity())
+    {
+        // grow geometrically so that many small writes are amortized
+        _core.reserve(std::max(size + length, 1 + _core.capacity() * 3 / 2));
+    }
     _core.resize(size + length);
     std::copy(s, s + length, _core.mutable_data() + size);
     return *this;
@@ -19,6 +19,10 @@
 
 #include "native/config.h"
 
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
 namespace native
 {
 
@@ -138,6 +142,92 @@ struct utf8
                 throw std::runtime_error("invalid utf-8 sequence");
         }
     }
+
+    // Validates the sequence starting at first. Returns the end of the
+    // sequence or nullptr if it is not well-formed UTF-8 as defined by
+    // RFC 3629 (no overlong forms, surrogates or codepoints above U+10FFFF).
+    static const char* validate_sequence(const char* first, const char* last)
+    {
+        const auto* p = reinterpret_cast<const unsigned char*>(first);
+        const auto* end = reinterpret_cast<const unsigned char*>(last);
+
+        // second byte range for each lead byte, the rest are 0x80-0xbf
+        unsigned char lower = 0x80;
+        unsigned char upper = 0xbf;
+        std::size_t length = 0;
+        if (*p < 0x80)
+        {
+            return first + 1;
+        }
+        else if (*p < 0xc2)
+        {
+            return nullptr; // continuation or overlong 2 byte
+        }
+        else if (*p < 0xe0)
+        {
+            length = 2;
+        }
+        else if (*p < 0xf0)
+        {
+            length = 3;
+            lower = *p == 0xe0 ? 0xa0 : 0x80;
+            upper = *p == 0xed ? 0x9f : 0xbf;
+        }
+        else if (*p < 0xf5)
+        {
+            length = 4;
+            lower = *p == 0xf0 ? 0x90 : 0x80;
+            upper = *p == 0xf4 ? 0x8f : 0xbf;
+        }
+        else
+        {
+            return nullptr;
+        }
+
+        if (static_cast<std::size_t>(end - p) < length || p[1] < lower ||
+            p[1] > upper)
+        {
+            return nullptr;
+        }
+        for (std::size_t i = 2; i < length; ++i)
+        {
+            if ((p[i] & 0xc0) != 0x80)
+            {
+                return nullptr;
+            }
+        }
+        return first + length;
+    }
+
+    // Returns true if [first, last) is well-formed UTF-8.
+    static bool validate(const char* first, const char* last)
+    {
+        while (first != last)
+        {
+            // skip ahead 8 ASCII characters at a time
+            std::uint64_t word;
+            while (last - first >= 8)
+            {
+                std::memcpy(&word, first, sizeof(word));
+                if (word & 0x8080808080808080ULL)
+                {
+                    break;
+                }
+                first += 8;
+            }
+            if (first == last)
+            {
+                break;
+            }
+
+            first = validate_sequence(first, last);
+            if (!first)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
 };
 
 // UTF-16 encoding
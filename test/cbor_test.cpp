@@ -0,0 +1,346 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/cbor/parser.h"
+#include "native/cbor/writer.h"
+#include "native/json.h"
+#include "native/json/output_streams.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+using namespace native;
+
+namespace
+{
+
+// Records the callbacks, with the type of each number.
+struct trace_handler
+{
+    using char_type = char;
+
+    json::data_type start_array()
+    {
+        trace += "[ ";
+        return array_type;
+    }
+    void end_array() { trace += "] "; }
+
+    void start_object() { trace += "{ "; }
+    void end_object() { trace += "} "; }
+
+    json::data_type key(const char_type* key, std::size_t length)
+    {
+        trace += std::string(key, length) + ": ";
+        return std::string(key, length) == "age" ? json::type_unsigned_short
+                                                 : json::type_unknown;
+    }
+
+    void value(const char_type* val, std::size_t length)
+    {
+        trace += "\"" + std::string(val, length) + "\" ";
+    }
+    void value(std::nullptr_t) { trace += "null "; }
+    void value(bool val) { trace += val ? "true " : "false "; }
+    void value(unsigned short val) { number("u16", val); }
+    void value(std::int32_t val) { number("i32", val); }
+    void value(std::uint32_t val) { number("u32", val); }
+    void value(std::int64_t val) { number("i64", val); }
+    void value(std::uint64_t val) { number("u64", val); }
+    void value(long long val) { number("ll", val); }
+    void value(unsigned long long val) { number("ull", val); }
+    void value(float val) { number("f", val); }
+    void value(double val) { number("d", val); }
+    void value(long double val) { number("ld", val); }
+
+    template <typename T>
+    void number(const char* type, T val)
+    {
+        trace += std::string(type) + ":" + std::to_string(val) + " ";
+    }
+
+    json::data_type array_type = json::type_unknown;
+    std::string trace;
+};
+
+// "1a000f4240" -> "\x1a\x00\x0f\x42\x40"
+std::string hex(const std::string& digits)
+{
+    std::string bytes;
+    for (std::size_t i = 0; i + 1 < digits.size(); i += 2)
+    {
+        bytes.push_back(
+            static_cast<char>(std::stoi(digits.substr(i, 2), nullptr, 16)));
+    }
+    return bytes;
+}
+
+std::string trace(const std::string& digits,
+                  json::data_type array_type = json::type_unknown)
+{
+    trace_handler handler;
+    handler.array_type = array_type;
+    cbor::parser{}.parse(hex(digits), handler);
+    return handler.trace;
+}
+
+} // namespace
+
+// RFC 8949 appendix A
+TEST(cbor_test, parse)
+{
+    EXPECT_EQ("u32:0 ", trace("00"));
+    EXPECT_EQ("u32:23 ", trace("17"));
+    EXPECT_EQ("u32:24 ", trace("1818"));
+    EXPECT_EQ("u32:1000000 ", trace("1a000f4240"));
+    EXPECT_EQ("u64:1000000000000 ", trace("1b000000e8d4a51000"));
+    EXPECT_EQ("u64:18446744073709551615 ", trace("1bffffffffffffffff"));
+    EXPECT_EQ("i32:-1 ", trace("20"));
+    EXPECT_EQ("i32:-1000 ", trace("3903e7"));
+    EXPECT_EQ("i64:-1000000000000 ", trace("3b000000e8d4a50fff"));
+    EXPECT_EQ("d:-18446744073709551616.000000 ", trace("3bffffffffffffffff"));
+
+    EXPECT_EQ("d:0.000000 ", trace("f90000"));
+    EXPECT_EQ("d:-4.000000 ", trace("f9c400"));
+    EXPECT_EQ("d:65504.000000 ", trace("f97bff"));
+    EXPECT_EQ("d:100000.000000 ", trace("fa47c35000"));
+    EXPECT_EQ("d:1.100000 ", trace("fb3ff199999999999a"));
+    EXPECT_EQ("d:inf ", trace("f97c00"));
+
+    EXPECT_EQ("false ", trace("f4"));
+    EXPECT_EQ("true ", trace("f5"));
+    EXPECT_EQ("null ", trace("f6"));
+    EXPECT_EQ("null ", trace("f7"));
+
+    EXPECT_EQ("\"\" ", trace("40"));
+    EXPECT_EQ("\"IETF\" ", trace("6449455446"));
+    EXPECT_EQ("\"\xc3\xbc\" ", trace("62c3bc"));
+
+    EXPECT_EQ("[ u32:1 [ u32:2 u32:3 ] [ u32:4 u32:5 ] ] ",
+              trace("8301820203820405"));
+    EXPECT_EQ("{ a: u32:1 b: [ u32:2 u32:3 ] } ",
+              trace("a26161016162820203"));
+}
+
+TEST(cbor_test, indefinite_length)
+{
+    EXPECT_EQ("\"\" ", trace("7fff"));
+    EXPECT_EQ("\"streaming\" ", trace("7f657374726561646d696e67ff"));
+    EXPECT_EQ("\"\x01\x02\x03\x04\x05\" ", trace("5f42010243030405ff"));
+    EXPECT_EQ("[ ] ", trace("9fff"));
+    EXPECT_EQ("[ u32:1 [ u32:2 u32:3 ] [ u32:4 u32:5 ] ] ",
+              trace("9f018202039f0405ffff"));
+    EXPECT_EQ("{ a: u32:1 b: [ u32:2 u32:3 ] } ",
+              trace("bf61610161629f0203ffff"));
+    EXPECT_EQ("{ Fun: true Amt: i32:-2 } ",
+              trace("bf6346756ef563416d7421ff"));
+}
+
+TEST(cbor_test, tags)
+{
+    // date/time strings and epoch times are passed on unchanged
+    EXPECT_EQ("\"2013-03-21T20:04:00Z\" ",
+              trace("c074323031332d30332d32315432303a30343a30305a"));
+    EXPECT_EQ("u32:1363896240 ", trace("c11a514b67b0"));
+    EXPECT_EQ("d:1363896240.500000 ", trace("c1fb41d452d9ec200000"));
+
+    // bignums
+    EXPECT_EQ("u32:1 ", trace("c243000001"));
+    EXPECT_EQ("i32:-2 ", trace("c34101"));
+    EXPECT_EQ("u64:18446744073709551615 ", trace("c248ffffffffffffffff"));
+    EXPECT_EQ("d:18446744073709551616.000000 ",
+              trace("c249010000000000000000"));
+    EXPECT_EQ("d:-18446744073709551616.000000 ",
+              trace("c349010000000000000000"));
+
+    // decimal fraction and bigfloat
+    EXPECT_EQ("d:273.150000 ", trace("c48221196ab3"));
+    EXPECT_EQ("d:1.500000 ", trace("c5822003"));
+
+    // unknown tags are skipped, and typing still applies
+    EXPECT_EQ("[ f:1.000000 ] ", trace("81d82001", json::type_float));
+    EXPECT_EQ("[ ull:1 ] ", trace("81c24101",
+                                  json::type_unsigned_long_long));
+    EXPECT_THROW(trace("81c249010000000000000000", json::type_long_long),
+                 cbor::number_too_big_for_expected_type);
+    EXPECT_THROW(trace("c26161"), cbor::invalid_tag_content);
+    EXPECT_THROW(trace("c401"), cbor::invalid_tag_content);
+}
+
+TEST(cbor_test, expected_types)
+{
+    EXPECT_EQ("{ age: u16:70 name: \"jack\" } ",
+              trace("a263616765184664"
+                    "6e616d65646a61636b"));
+    EXPECT_THROW(trace("a1636167651a00011170"),
+                 cbor::number_too_big_for_expected_type);
+    EXPECT_THROW(trace("a16361676520"), cbor::unexpected_signed_value);
+    EXPECT_THROW(trace("a163616765f93e00"), cbor::unexpected_decimal_value);
+}
+
+TEST(cbor_test, zero_copy)
+{
+    struct span_handler : json::handler<>
+    {
+        using json::handler<>::value;
+
+        json::data_type key(const char* key, std::size_t length)
+        {
+            keys.emplace_back(key, length);
+            return json::type_unknown;
+        }
+        void value(const char* val, std::size_t length)
+        {
+            values.emplace_back(val, length);
+        }
+
+        std::vector<std::pair<const char*, std::size_t>> keys;
+        std::vector<std::pair<const char*, std::size_t>> values;
+    };
+
+    const auto input = hex("a1616b43010203");
+    span_handler handler;
+    cbor::parser{}.parse(input, handler);
+
+    ASSERT_EQ(1u, handler.keys.size());
+    EXPECT_EQ(input.data() + 2, handler.keys[0].first);
+    EXPECT_EQ(1u, handler.keys[0].second);
+    ASSERT_EQ(1u, handler.values.size());
+    EXPECT_EQ(input.data() + 4, handler.values[0].first);
+    EXPECT_EQ(3u, handler.values[0].second);
+}
+
+TEST(cbor_test, errors)
+{
+    EXPECT_THROW(trace("8201"), cbor::unexpected_end_of_input);
+    EXPECT_THROW(trace("6578"), cbor::unexpected_end_of_input);
+    EXPECT_THROW(trace("9f01"), cbor::unexpected_end_of_input);
+    EXPECT_THROW(trace("1c"), cbor::invalid_type);
+    EXPECT_THROW(trace("f0"), cbor::invalid_type);
+    EXPECT_THROW(trace("ff"), cbor::unexpected_break);
+    EXPECT_THROW(trace("7f4161ff"), cbor::invalid_string_chunk);
+    EXPECT_THROW(trace("7f7f6161ffff"), cbor::invalid_string_chunk);
+    EXPECT_THROW(trace("a10101"), cbor::expected_string_key);
+    EXPECT_THROW(trace("8080"), cbor::expected_end_of_input);
+    EXPECT_THROW(trace(std::string(4000, '8') + "1f6"),
+                 cbor::nesting_too_deep);
+    EXPECT_THROW(trace(std::string(4000, 'c') + "1f6"),
+                 cbor::nesting_too_deep);
+
+    // a huge count doesn't reserve anything
+    EXPECT_THROW(trace("9bffffffffffffffff"
+                       "f6"),
+                 cbor::unexpected_end_of_input);
+    EXPECT_THROW(trace("7bffffffffffffffff"),
+                 cbor::unexpected_end_of_input);
+
+    trace_handler handler;
+    const auto two = hex("810161");
+    EXPECT_EQ(2u, cbor::parser{}.parse_prefix(two.data(), two.size(),
+                                              handler));
+    EXPECT_EQ("[ u32:1 ] ", handler.trace);
+}
+
+TEST(cbor_test, write)
+{
+    std::string output;
+    json::string_stream<> ostr{output};
+    cbor::writer<json::string_stream<>> writer{ostr};
+    writer.open_array(17);
+    writer.append(0);
+    writer.append(23);
+    writer.append(24);
+    writer.append(1000000);
+    writer.append(std::numeric_limits<unsigned long long>::max());
+    writer.append(-1);
+    writer.append(-1000);
+    writer.append(std::numeric_limits<long long>::min());
+    writer.append(1.5);
+    writer.append(1.1);
+    writer.append(100000.0f);
+    writer.append(nullptr);
+    writer.append(true);
+    writer.append("IETF");
+    writer.append_bytes("\x01\x02", 2);
+    writer.tag(1);
+    writer.append(1363896240);
+    writer.open_object(2);
+    writer.append("a", 1);
+    writer.append(NATIVE_JSON_KEY("b"), std::string("c"));
+    writer.close_object();
+    writer.close_array();
+
+    EXPECT_EQ(hex("91"
+                  "00"
+                  "17"
+                  "1818"
+                  "1a000f4240"
+                  "1bffffffffffffffff"
+                  "20"
+                  "3903e7"
+                  "3b7fffffffffffffff"
+                  "fa3fc00000"
+                  "fb3ff199999999999a"
+                  "fa47c35000"
+                  "f6"
+                  "f5"
+                  "6449455446"
+                  "420102"
+                  "c11a514b67b0"
+                  "a261610161626163"),
+              output);
+}
+
+TEST(cbor_test, write_indefinite)
+{
+    std::string output;
+    json::string_stream<> ostr{output};
+    cbor::writer<json::string_stream<>> writer{ostr};
+    writer.open_object();
+    writer.append("Fun", true);
+    writer.key("Amt");
+    writer.open_array();
+    writer.append(-2);
+    writer.close_array();
+    writer.close_object();
+
+    EXPECT_EQ(hex("bf6346756ef563416d749f21ffff"), output);
+    EXPECT_EQ("{ Fun: true Amt: [ i32:-2 ] } ",
+              trace("bf6346756ef563416d749f21ffff"));
+}
+
+TEST(cbor_test, any_round_trip)
+{
+    const std::string text = R"json({
+  "array": [2, "c++", -7, 1.5, 0.1, null, true, [], {}],
+  "nested": {"color": "orange", "problems": 99, "big": 10000000000},
+  "unicode": "ö€"
+})json";
+    const auto value = json::parse(text.data(), text.size());
+
+    std::string bytes;
+    json::string_stream<> ostr{bytes};
+    cbor::writer<json::string_stream<>> writer{ostr};
+    value.dump(writer, true);
+
+    json::any result;
+    json::any::handler handler{result};
+    cbor::parser{}.parse(bytes, handler);
+    EXPECT_EQ(value.dump(true), result.dump(true));
+}
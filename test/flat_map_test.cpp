@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/flat_map.h"
+
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace native;
+
+TEST(flat_map_test, insertion_order)
+{
+    flat_map<std::string, int> map{{"c", 3}, {"a", 1}, {"b", 2}, {"a", 4}};
+    EXPECT_EQ(3u, map.size());
+    EXPECT_EQ(1, map["a"]);
+
+    map["0"] = 0;
+    std::string keys;
+    for (const auto& item : map)
+    {
+        keys += item.first;
+    }
+    EXPECT_EQ("cab0", keys);
+
+    EXPECT_FALSE(map.insert({"c", 5}).second);
+    EXPECT_EQ(3, map.at("c"));
+    EXPECT_THROW(map.at("d"), std::out_of_range);
+
+    EXPECT_EQ(1u, map.erase("a"));
+    EXPECT_EQ(0u, map.erase("a"));
+    EXPECT_EQ(map.end(), map.find("a"));
+    EXPECT_EQ("b", map.begin()[1].first);
+}
+
+TEST(flat_map_test, indexed)
+{
+    flat_map<std::string, int> map;
+    for (int i = 0; i < 1000; ++i)
+    {
+        map[std::to_string(i)] = i;
+    }
+    EXPECT_EQ(1000u, map.size());
+    for (int i = 0; i < 1000; ++i)
+    {
+        ASSERT_EQ(i, map.at(std::to_string(i)));
+    }
+    EXPECT_EQ(0u, map.count("1000"));
+
+    // erasing moves the rest down and keeps them findable
+    for (int i = 0; i < 1000; i += 2)
+    {
+        map.erase(std::to_string(i));
+    }
+    EXPECT_EQ(500u, map.size());
+    EXPECT_EQ("1", map.begin()->first);
+    for (int i = 1; i < 1000; i += 2)
+    {
+        ASSERT_EQ(i, map.at(std::to_string(i)));
+    }
+
+    // and back to a linear search
+    while (map.size() > 3)
+    {
+        map.erase(map.begin());
+    }
+    EXPECT_EQ(999, map["999"]);
+    EXPECT_EQ(3u, map.size());
+}
+
+namespace
+{
+
+// Few distinct hashes, so probe runs are long and wrap around the table.
+struct clustered_hash
+{
+    std::size_t operator()(int key) const
+    {
+        return static_cast<std::size_t>(key % 3) * 13;
+    }
+};
+
+} // namespace
+
+TEST(flat_map_test, erase_collisions)
+{
+    flat_map<int, int, clustered_hash> map;
+    std::map<int, int> expected;
+    std::mt19937 random{7};
+    for (int round = 0; round < 2000; ++round)
+    {
+        const auto key = static_cast<int>(random() % 64);
+        if (random() % 3)
+        {
+            map[key] = round;
+            expected[key] = round;
+        }
+        else
+        {
+            ASSERT_EQ(expected.erase(key), map.erase(key));
+        }
+
+        ASSERT_EQ(expected.size(), map.size());
+        for (int i = 0; i < 64; ++i)
+        {
+            const auto it = expected.find(i);
+            if (it == expected.end())
+            {
+                ASSERT_EQ(0u, map.count(i));
+            }
+            else
+            {
+                ASSERT_EQ(it->second, map.at(i));
+            }
+        }
+    }
+}
+
+TEST(flat_map_test, equality)
+{
+    flat_map<std::string, int> left{{"a", 1}, {"b", 2}};
+    flat_map<std::string, int> right{{"b", 2}, {"a", 1}};
+    EXPECT_EQ(left, right);
+
+    right["a"] = 3;
+    EXPECT_NE(left, right);
+
+    right.erase("a");
+    EXPECT_NE(left, right);
+
+    left.swap(right);
+    EXPECT_EQ(1u, left.size());
+    EXPECT_EQ(2u, right.size());
+}
@@ -18,6 +18,11 @@
 
 #include "native/json.h"
 
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_set>
+
 using namespace native;
 
 TEST(json_any_test, pod_types)
@@ -218,6 +223,15 @@ TEST(json_any_test, dump)
               json);
 }
 
+TEST(json_any_test, dump_writer)
+{
+    json::any value{{{"κόσμε", "λόγος"}, {"foo", 42}}};
+    std::ostringstream ostr;
+    json::writer<std::ostringstream> writer{ostr, 0, json::utf8_raw};
+    value.dump(writer, true);
+    EXPECT_EQ(R"json({"foo":42,"κόσμε":"λόγος"})json", ostr.str());
+}
+
 TEST(json_any_test, parse)
 {
     auto json = istring::literal(R"json({
@@ -259,3 +273,354 @@ TEST(json_any_test, parse_std_string)
 
     EXPECT_EQ(json, value.dump(true, 2));
 }
+
+TEST(json_any_test, dump_parallel)
+{
+    json::any value{{{"first", 1}, {"second", "two"}}};
+    json::any large{{0, "one", 2.5}};
+    for (int i = 0; i < 1000; ++i)
+    {
+        json::any element{{{"index", i}, {"name", "element"}}};
+        element["array"] = json::any{json::json_array};
+        element["array"].push_back(i);
+        element["array"].push_back("element");
+        large.push_back(element);
+    }
+    // the large array is nested, so the root isn't split
+    value["large"] = large;
+
+    for (std::size_t indent : {0, 2})
+    {
+        const auto expected = value.dump(true, indent);
+        for (unsigned threads : {1, 2, 3, 8})
+        {
+            EXPECT_EQ(expected, value.dump_parallel(true, indent, threads));
+
+            std::string str;
+            value.dump_parallel(str, true, indent, threads);
+            EXPECT_EQ(std::string(expected.data(), expected.size()), str);
+        }
+    }
+
+    json::any empty{json::json_array};
+    EXPECT_EQ("[]", empty.dump_parallel(false, 2, 4));
+
+    // errors in any chunk are thrown once all threads are done
+    large.push_back(istring("\xff\xfe"));
+    for (unsigned threads : {2, 8})
+    {
+        std::string str{"unchanged"};
+        EXPECT_THROW(large.dump_parallel(str, false, 0, threads),
+                     std::runtime_error);
+        EXPECT_EQ("unchanged", str);
+    }
+}
+
+TEST(json_any_test, dump_sorted_after_changes)
+{
+    json::any value{{{"b", 2}, {"c", 3}, {"a", 1}}};
+    EXPECT_EQ(R"({"a":1,"b":2,"c":3})", value.dump(true));
+    EXPECT_EQ(R"({"a":1,"b":2,"c":3})", value.dump(true));
+
+    // changing a value keeps the order
+    value["b"] = 5;
+    EXPECT_EQ(R"({"a":1,"b":5,"c":3})", value.dump(true));
+
+    value["0"] = 0;
+    EXPECT_EQ(R"({"0":0,"a":1,"b":5,"c":3})", value.dump(true));
+
+    value.erase("a");
+    value["d"] = 4;
+    EXPECT_EQ(R"({"0":0,"b":5,"c":3,"d":4})", value.dump(true));
+
+    value.erase(value.find("c"));
+    EXPECT_EQ(R"({"0":0,"b":5,"d":4})", value.dump(true));
+
+    // copies have their own order
+    json::any copy = value;
+    copy["e"] = 6;
+    EXPECT_EQ(R"({"0":0,"b":5,"d":4})", value.dump(true));
+    EXPECT_EQ(R"({"0":0,"b":5,"d":4,"e":6})", copy.dump(true));
+    EXPECT_EQ(copy.dump(true), copy.dump_parallel(true, 0, 2));
+}
+
+TEST(json_any_test, ordered_objects)
+{
+    const auto text =
+        R"({"z":1,"y":{"b":true,"a":null},"x":[{"2":2,"1":1}],"w":"w"})";
+    auto value = json::parse<json::ordered_any>(text, std::strlen(text));
+    EXPECT_EQ(text, value.dump());
+    EXPECT_EQ(R"({"w":"w","x":[{"1":1,"2":2}],"y":{"a":null,"b":true},"z":1})",
+              value.dump(true));
+
+    value["a"] = 0;
+    value.erase("y");
+    EXPECT_EQ(R"({"z":1,"x":[{"2":2,"1":1}],"w":"w","a":0})", value.dump());
+
+    std::string keys;
+    for (const auto& key : value.keys())
+    {
+        keys += key.c_str();
+    }
+    EXPECT_EQ("zxwa", keys);
+
+    // equality ignores order
+    json::ordered_any other{{{"a", 0}, {"w", "w"}, {"z", 1}}};
+    other["x"] = value["x"];
+    EXPECT_EQ(value, other);
+}
+
+TEST(json_any_test, compact_layout)
+{
+    EXPECT_EQ(2 * sizeof(void*), sizeof(json::any));
+    EXPECT_EQ(2 * sizeof(void*), sizeof(json::ordered_any));
+
+    json::any value{{1, "two", 3.5, json::any::object{{"four", 4}}}};
+    auto copy = value;
+    auto moved = std::move(value);
+    EXPECT_TRUE(value.is_null());
+    EXPECT_EQ(copy, moved);
+
+    moved = moved;
+    EXPECT_EQ(copy, moved);
+    moved = copy[3];
+    EXPECT_EQ(4, moved["four"].int_value());
+    EXPECT_EQ(R"([1,"two",3.5,{"four":4}])", copy.dump());
+}
+
+TEST(json_any_test, handler_size_hints)
+{
+    const std::string first = R"({"a":[1,2,3],"b":{"c":[]},"d":"e"})";
+    json::any value;
+    json::any::handler handler{value};
+    json::parser{}.parse(first, handler);
+    EXPECT_EQ(first, value.dump(true));
+    EXPECT_EQ((json::any::handler::size_hints{3, 3, 1, 0}), handler.sizes());
+
+    // a similar document reserves with the sizes of the first
+    const std::string second = R"({"a":[4,5,6,7],"b":{"c":[8]},"d":null})";
+    json::any next;
+    json::any::handler hinted{next, handler.sizes()};
+    json::parser{}.parse(second, hinted);
+    EXPECT_EQ(json::parse(second.data(), second.size()), next);
+    EXPECT_EQ((json::any::handler::size_hints{3, 4, 1, 1}), hinted.sizes());
+}
+
+TEST(json_any_test, lazy_numbers)
+{
+    const std::string text =
+        R"({"big":123456789012345678901234567890,"pi":3.14159265358979323846,)"
+        R"("small":-42,"exp":1E+2,"list":[0,-0.5]})";
+    json::ordered_any value;
+    json::ordered_any::handler handler{value, json::number_lazy};
+    json::parser{}.parse(text, handler);
+
+    // written back exactly as parsed
+    EXPECT_EQ(text, value.dump());
+    EXPECT_EQ("3.14159265358979323846", value["pi"].string_value());
+
+    EXPECT_TRUE(value["small"].is_int());
+    EXPECT_TRUE(value["exp"].is_double());
+    EXPECT_EQ(-42, value["small"].int_value());
+    EXPECT_EQ(100, value["exp"].int_value());
+    EXPECT_DOUBLE_EQ(3.14159265358979323846, value["pi"].double_value());
+    EXPECT_DOUBLE_EQ(-0.5, value["list"][1].double_value());
+
+    // integers too large for 64 bits are reals
+    EXPECT_TRUE(value["big"].is_double());
+    EXPECT_DOUBLE_EQ(1.2345678901234568e29, value["big"].double_value());
+    EXPECT_EQ(std::numeric_limits<long long>::max(), value["big"].int_value());
+    EXPECT_EQ(json::ordered_any{1.2345678901234568e29}, value["big"]);
+    EXPECT_EQ(json::ordered_any{1.2345678901234568e29}.hash(),
+              value["big"].hash());
+
+    // compared by value, and copies keep the text
+    const auto copy = value;
+    EXPECT_EQ(json::ordered_any{-42}, copy["small"]);
+    EXPECT_EQ(json::ordered_any{100.0}, copy["exp"]);
+    EXPECT_EQ(text, copy.dump());
+
+    // other formats are given the value
+    json::ordered_any numbers;
+    json::ordered_any::handler lazy{numbers, json::number_lazy};
+    json::parser{}.parse(std::string{"[1,2.5,1e2,-123456789012345678901]"},
+                         lazy);
+    EXPECT_EQ("[1,2.5,100,-123456789012345680000]", numbers.dump_canonical());
+
+    const std::string source{"[1,2.5,100.0,-123456789012345678901.0]"};
+    const auto converted =
+        json::parse<json::ordered_any>(source.data(), source.size());
+    std::string packed;
+    std::string expected;
+    json::string_stream<> packed_stream{packed};
+    json::string_stream<> expected_stream{expected};
+    msgpack::writer<json::string_stream<>> packed_writer{packed_stream};
+    msgpack::writer<json::string_stream<>> expected_writer{expected_stream};
+    numbers.dump(packed_writer);
+    converted.dump(expected_writer);
+    EXPECT_EQ(expected, packed);
+}
+
+TEST(json_any_test, share)
+{
+    const std::string text =
+        R"({"servers":[{"host":"a","port":1},{"host":"b","port":2}],)"
+        R"("limits":{"rate":10}})";
+    auto config = json::parse(text.data(), text.size());
+    const auto snapshot = config.share();
+    EXPECT_EQ(config, snapshot);
+    EXPECT_EQ(&snapshot["servers"][1],
+              &static_cast<const json::any&>(config)["servers"][1]);
+
+    // only the path to the change is copied
+    config["servers"][0]["port"] = 3;
+    config["servers"].push_back("c");
+    EXPECT_EQ(1, snapshot["servers"][0]["port"].int_value());
+    EXPECT_EQ(2u, snapshot["servers"].size());
+    EXPECT_EQ(3, config["servers"][0]["port"].int_value());
+    EXPECT_EQ(3u, config["servers"].size());
+    EXPECT_EQ(&snapshot["limits"]["rate"],
+              &static_cast<const json::any&>(config)["limits"]["rate"]);
+    EXPECT_EQ(&snapshot["servers"][1]["host"],
+              &static_cast<const json::any&>(config)["servers"][1]["host"]);
+
+    // erasing through an iterator into the shared array
+    auto copy = snapshot.share();
+    copy["servers"].erase(copy["servers"].begin());
+    EXPECT_EQ("b", copy["servers"][0]["host"].string_value());
+    EXPECT_EQ(2u, snapshot["servers"].size());
+
+    const std::string numbers_text{"[1,2,3,4]"};
+    const auto numbers =
+        json::parse(numbers_text.data(), numbers_text.size());
+    auto shared = numbers.share();
+    const auto& cshared = shared;
+    shared.erase(cshared.begin() + 1, cshared.begin() + 3);
+    EXPECT_EQ("[1,4]", shared.dump());
+    EXPECT_EQ("[1,2,3,4]", numbers.dump());
+
+    // references taken before sharing only write to the original
+    auto& limits = config["limits"];
+    auto& rate = limits["rate"];
+    const auto later = config.share();
+    limits["burst"] = 5;
+    rate = 20;
+    EXPECT_EQ(10, later["limits"]["rate"].int_value());
+    EXPECT_EQ(1u, later["limits"].size());
+    EXPECT_EQ(20, config["limits"]["rate"].int_value());
+
+    // a snapshot outlives the value it was taken from
+    auto other = json::any{snapshot["limits"]}.share();
+    config = nullptr;
+    EXPECT_EQ(10, snapshot["limits"]["rate"].int_value());
+    EXPECT_EQ(snapshot["limits"], other);
+}
+
+TEST(json_any_test, key_lookup)
+{
+    const std::string text = R"({"name":"a","count":2,"long key for heap":3})";
+    auto value = json::parse(text.data(), text.size());
+    const auto& cvalue = value;
+
+    constexpr auto count_key = NATIVE_JSON_HASHED_KEY("count");
+    EXPECT_EQ(istring("count").hash(), count_key.hash());
+
+    const char* name = "name";
+    char buffer[32] = "count";
+    EXPECT_EQ("a", cvalue["name"].string_value());
+    EXPECT_EQ("a", cvalue[name].string_value());
+    EXPECT_EQ(2, cvalue[buffer].int_value());
+    EXPECT_EQ(2, cvalue[std::string{"count"}].int_value());
+    EXPECT_EQ(2, cvalue[string_slice{"count"}].int_value());
+    EXPECT_EQ(2, cvalue[count_key].int_value());
+    EXPECT_EQ(3, cvalue["long key for heap"].int_value());
+    EXPECT_EQ(2, value.find(count_key)->second.int_value());
+    EXPECT_EQ(value.find(istring("name")), value.find("name"));
+    EXPECT_THROW(cvalue["missing"], std::out_of_range);
+
+    // a member added through a key owns its own copy of it
+    {
+        std::string key = "a key that outlives nothing here";
+        value[key] = 4;
+        value[count_key] = 5;
+        key.assign(key.size(), 'x');
+    }
+    EXPECT_EQ(4u, value.size());
+    EXPECT_EQ(4, cvalue["a key that outlives nothing here"].int_value());
+    EXPECT_EQ(5, cvalue[istring("count")].int_value());
+}
+
+TEST(json_any_test, hash)
+{
+    const std::string text =
+        R"({"a":[1,2.5,"x",null,true],)"
+        R"("b":{"c":-0.0,"d":"long enough for the heap"}})";
+    const std::string reordered =
+        R"({"b":{"d":"long enough for the heap","c":0.0},)"
+        R"("a":[1,2.5,"x",null,true]})";
+    const auto parse = [](const std::string& s)
+    {
+        return json::parse(s.data(), s.size());
+    };
+    auto value = parse(text);
+    const auto other = parse(reordered);
+    EXPECT_EQ(value, other);
+    EXPECT_EQ(value.hash(), other.hash());
+    EXPECT_EQ(std::hash<json::any>{}(value), value.hash());
+
+    // arrays depend on order
+    EXPECT_NE(parse("[1,2]").hash(), parse("[2,1]").hash());
+    EXPECT_NE(parse("[1]").hash(), parse("[[1]]").hash());
+
+    // changes drop the kept hash
+    const auto before = value.hash();
+    value["b"]["c"] = 1;
+    EXPECT_NE(before, value.hash());
+    EXPECT_NE(value, other);
+    value["b"]["c"] = 0.0;
+    EXPECT_EQ(before, value.hash());
+    EXPECT_EQ(value, other);
+    value["a"].push_back(1);
+    EXPECT_NE(before, value.hash());
+    value["a"].pop_back();
+    EXPECT_EQ(before, value.hash());
+    value.erase(value.find("b"));
+    EXPECT_NE(other.hash(), value.hash());
+    EXPECT_NE(value, other);
+
+    // shared values are equal without comparing them
+    const auto shared = other.share();
+    EXPECT_EQ(other, shared);
+    EXPECT_FALSE(other != shared);
+    EXPECT_FALSE(other < shared);
+    EXPECT_FALSE(shared < other);
+
+    // nothing reached through a reference keeps a hash that could go stale
+    auto x = parse(R"({"k":{"y":1}})");
+    const auto y = parse(R"({"k":{"y":2}})");
+    y.hash();
+    auto& k = x["k"];
+    x.hash();
+    k["y"] = 2;
+    EXPECT_EQ(x, y);
+    EXPECT_EQ(y.hash(), x.hash());
+
+    // nor does an array a leaked object is moved into
+    json::any inner{json::json_object};
+    auto& z = inner["z"];
+    json::any outer{json::json_array};
+    outer.emplace_back(std::move(inner));
+    outer.hash();
+    z = 1;
+    EXPECT_EQ(parse(R"([{"z":1}])"), outer);
+    EXPECT_EQ(parse(R"([{"z":1}])").hash(), outer.hash());
+
+    std::unordered_set<json::any> seen;
+    seen.insert(x);
+    seen.insert(y.share());
+    seen.insert(outer);
+    k["y"] = 3;
+    EXPECT_EQ(2u, seen.size());
+    EXPECT_EQ(1u, seen.count(parse(R"({"k":{"y":2}})")));
+    EXPECT_EQ(0u, seen.count(x));
+}
@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json.h"
+#include "native/json/canonical_writer.h"
+#include "native/json/output_streams.h"
+#include "native/json/parser.h"
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+using namespace native;
+
+namespace
+{
+
+std::string canonicalize(const std::string& text)
+{
+    std::string result;
+    json::string_stream<> ostr{result};
+    json::canonical_writer<json::string_stream<>> writer{ostr};
+    json::parser{}.parse(text.data(), text.size(), writer);
+    return result;
+}
+
+template <typename T>
+std::string number(T value)
+{
+    std::string result;
+    json::string_stream<> ostr{result};
+    json::canonical_writer<json::string_stream<>> writer{ostr};
+    writer.append(value);
+    return result;
+}
+
+struct collecting_hasher
+{
+    void update(const char* s, std::size_t length)
+    {
+        text.append(s, length);
+        ++updates;
+    }
+
+    std::string text;
+    std::size_t updates = 0;
+};
+
+} // namespace
+
+// RFC 8785 section 3.2.4
+TEST(json_canonical_writer_test, rfc_example)
+{
+    const std::string text = R"json({
+  "numbers": [333333333.33333329, 1E30, 4.50,
+              2e-3, 0.000000000000000000000000001],
+  "string": "\u20ac$\u000F\u000aA'\u0042\u0022\u005c\\\"\/",
+  "literals": [null, true, false]
+})json";
+
+    EXPECT_EQ("{\"literals\":[null,true,false],"
+              "\"numbers\":[333333333.3333333,1e+30,4.5,0.002,1e-27],"
+              "\"string\":\"\xe2\x82\xac$\\u000f\\nA'B\\\"\\\\\\\\\\\"/\"}",
+              canonicalize(text));
+}
+
+// RFC 8785 section 3.2.3, UTF-16 order puts the emoji before U+FB33
+TEST(json_canonical_writer_test, sort_utf16)
+{
+    const std::string text = R"json({
+  "\u20ac": "Euro Sign",
+  "\r": "Carriage Return",
+  "\ufb33": "Hebrew Letter Dalet With Dagesh",
+  "1": "One",
+  "\ud83d\ude00": "Emoji: Grinning Face",
+  "\u0080": "Control",
+  "\u00f6": "Latin Small Letter O With Diaeresis"
+})json";
+
+    const std::string expected =
+        "{\"\\r\":\"Carriage Return\","
+        "\"1\":\"One\","
+        "\"\xc2\x80\":\"Control\","
+        "\"\xc3\xb6\":\"Latin Small Letter O With Diaeresis\","
+        "\"\xe2\x82\xac\":\"Euro Sign\","
+        "\"\xf0\x9f\x98\x80\":\"Emoji: Grinning Face\","
+        "\"\xef\xac\xb3\":\"Hebrew Letter Dalet With Dagesh\"}";
+    EXPECT_EQ(expected, canonicalize(text));
+
+    const auto value = json::parse(text.data(), text.size());
+    const auto dumped = value.dump_canonical();
+    EXPECT_EQ(expected, std::string(dumped.data(), dumped.size()));
+}
+
+TEST(json_canonical_writer_test, nested)
+{
+    EXPECT_EQ(R"({"a":[{"x":1,"y":{"m":[],"n":{}}},3],"b":{"c":2,"d":null}})",
+              canonicalize(R"( { "b" : { "d" : null, "c" : 2 },
+                                 "a" : [ { "y" : { "n" : { }, "m" : [ ] },
+                                           "x" : 1 }, 3 ] } )"));
+    EXPECT_EQ("[1,\"two\",[]]", canonicalize("[ 1, \"two\", [ ] ]"));
+    EXPECT_EQ("[\"\x7f/\"]", canonicalize("[\"\\u007f\\/\"]"));
+}
+
+// RFC 8785 appendix B
+TEST(json_canonical_writer_test, numbers)
+{
+    EXPECT_EQ("0", number(0.0));
+    EXPECT_EQ("0", number(-0.0));
+    EXPECT_EQ("5e-324", number(5e-324));
+    EXPECT_EQ("-5e-324", number(-5e-324));
+    EXPECT_EQ("1.7976931348623157e+308", number(1.7976931348623157e308));
+    EXPECT_EQ("9007199254740992", number(9007199254740992.0));
+    EXPECT_EQ("-9007199254740992", number(-9007199254740992.0));
+    EXPECT_EQ("295147905179352830000", number(295147905179352830000.0));
+    EXPECT_EQ("9.999999999999997e+22", number(9.999999999999997e+22));
+    EXPECT_EQ("1e+23", number(1e23));
+    EXPECT_EQ("1.0000000000000001e+23", number(1.0000000000000001e23));
+    EXPECT_EQ("999999999999999700000", number(999999999999999700000.0));
+    EXPECT_EQ("1e+21", number(1e21));
+    EXPECT_EQ("0.000001", number(0.000001));
+    EXPECT_EQ("1e-7", number(1e-7));
+    EXPECT_EQ("333333333.3333332", number(333333333.3333332));
+
+    // integers that a double can't hold are written as the nearest double
+    EXPECT_EQ("42", number(42));
+    EXPECT_EQ("-9007199254740992", number(-9007199254740992LL));
+    EXPECT_EQ("9007199254740992", number(9007199254740993LL));
+    EXPECT_EQ("9223372036854776000",
+              number(std::numeric_limits<long long>::max()));
+    EXPECT_EQ("18446744073709552000",
+              number(std::numeric_limits<unsigned long long>::max()));
+
+    EXPECT_THROW(number(std::numeric_limits<double>::infinity()),
+                 std::runtime_error);
+    EXPECT_THROW(number(std::numeric_limits<double>::quiet_NaN()),
+                 std::runtime_error);
+    EXPECT_THROW(number(std::string("\xff")), std::runtime_error);
+}
+
+TEST(json_canonical_writer_test, hash_stream)
+{
+    json::any value{json::json_object};
+    value["zeta"] = "the last one";
+    value["alpha"] = 1.5;
+    value["list"] = json::any{json::json_array};
+    for (int i = 0; i < 1000; ++i)
+    {
+        value["list"].push_back(i);
+    }
+
+    collecting_hasher hasher;
+    {
+        json::hash_stream<collecting_hasher, 256> ostr{hasher};
+        json::canonical_writer<decltype(ostr)> writer{ostr};
+        value.dump(writer);
+        ostr.flush();
+    }
+
+    const auto expected = value.dump_canonical();
+    EXPECT_EQ(std::string(expected.data(), expected.size()), hasher.text);
+    EXPECT_EQ(0u, hasher.text.find("{\"alpha\":1.5,\"list\":[0,1,2,"));
+    EXPECT_GE(hasher.updates, hasher.text.size() / 256);
+    EXPECT_LE(hasher.updates, hasher.text.size() / 256 + 1);
+}
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json.h"
+#include "native/json/document.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace native;
+
+namespace
+{
+
+const std::string text = R"json({
+  "array": [2, "c++", -7, 1.5, null, true, [], {}],
+  "nested": {"color": "orange", "problems": 99, "big": 10000000000},
+  "long": "a string that is too long to be stored inside the istring",
+  "unicode": "ö€"
+})json";
+
+} // namespace
+
+TEST(json_document_test, arena)
+{
+    json::arena arena{1024};
+    EXPECT_EQ(0u, arena.blocks());
+
+    auto* a = arena.allocate(3, 1);
+    auto* b = arena.allocate(8, 8);
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(b) % 8);
+    EXPECT_LT(a, b);
+    EXPECT_EQ(11u, arena.size());
+    EXPECT_EQ(1u, arena.blocks());
+
+    // too big for the first block
+    arena.allocate(4000);
+    EXPECT_EQ(2u, arena.blocks());
+
+    const char* copy = arena.copy("hello", 5);
+    EXPECT_STREQ("hello", copy);
+
+    arena.release();
+    EXPECT_EQ(0u, arena.blocks());
+    EXPECT_EQ(0u, arena.size());
+}
+
+TEST(json_document_test, allocator)
+{
+    json::arena arena;
+    {
+        json::arena::scope scope{arena};
+        EXPECT_EQ(&arena, json::arena::current());
+
+        std::vector<int, json::arena_allocator<int>> numbers;
+        numbers.assign(100, 42);
+        EXPECT_EQ(&arena, numbers.get_allocator().owner());
+        EXPECT_LE(100 * sizeof(int), arena.size());
+    }
+    EXPECT_EQ(nullptr, json::arena::current());
+
+    // the heap when no arena is current
+    const auto size = arena.size();
+    std::vector<int, json::arena_allocator<int>> numbers(100, 42);
+    EXPECT_EQ(nullptr, numbers.get_allocator().owner());
+    EXPECT_EQ(size, arena.size());
+}
+
+TEST(json_document_test, parse)
+{
+    json::document doc;
+    doc.parse(text);
+    EXPECT_EQ(nullptr, json::arena::current());
+
+    const auto expected = json::parse(text.data(), text.size());
+    EXPECT_EQ(expected.dump(true), doc.root().dump(true));
+    EXPECT_EQ(json::json_object, doc.root().type());
+    EXPECT_EQ(99, doc.root()["nested"]["problems"].int_value());
+    EXPECT_EQ("a string that is too long to be stored inside the istring",
+              doc.root()["long"].string_value());
+
+    // all of it fits in the first block
+    EXPECT_EQ(1u, doc.storage().blocks());
+    EXPECT_LT(text.size(), doc.storage().size());
+
+    // parsing again replaces the root
+    doc.parse(std::string{"[1, 2, 3]"});
+    EXPECT_EQ("[1,2,3]", doc.root().dump());
+}
+
+TEST(json_document_test, modify)
+{
+    json::document doc;
+    doc.parse(text);
+
+    const auto size = doc.storage().size();
+    {
+        json::arena::scope scope{doc.storage()};
+        auto& tags = doc.root()["tags"];
+        tags = json::document::value_type{json::json_array};
+        tags.push_back("first");
+        tags.push_back(2);
+    }
+    EXPECT_LT(size, doc.storage().size());
+    EXPECT_EQ("[\"first\",2]", doc.root()["tags"].dump());
+
+    // copies share the arena, so they must be gone before it is cleared
+    {
+        auto copy = doc.root()["nested"];
+        EXPECT_EQ(doc.root()["nested"], copy);
+    }
+
+    doc.clear();
+    EXPECT_TRUE(doc.root().is_null());
+    EXPECT_EQ(0u, doc.storage().blocks());
+}
+
+TEST(json_document_test, lazy_numbers)
+{
+    json::document doc;
+    doc.parse(std::string{R"({"id":12345678901234567890123,"rate":0.10})"},
+              json::number_lazy);
+    EXPECT_EQ(R"({"id":12345678901234567890123,"rate":0.10})",
+              doc.root().dump(true));
+    EXPECT_DOUBLE_EQ(0.1, doc.root()["rate"].double_value());
+    EXPECT_DOUBLE_EQ(1.2345678901234568e22, doc.root()["id"].double_value());
+    EXPECT_EQ(doc.root(), doc.root().share());
+}
@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json.h"
+#include "native/json/frozen.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace native;
+
+namespace
+{
+
+const std::string text = R"json({
+  "array": [2, "c++", -7, 1.5, null, true, [], {}],
+  "nested": {"color": "orange", "problems": 99, "big": 10000000000},
+  "long": "a string that is too long to be stored inside the istring"
+})json";
+
+struct counted
+{
+    explicit counted(int value, std::atomic<int>& live)
+        : value{value}
+        , live(live)
+    {
+        ++live;
+    }
+    ~counted() { --live; }
+
+    int value;
+    std::atomic<int>& live;
+};
+
+std::unique_ptr<const counted> make_counted(int value, std::atomic<int>& live)
+{
+    return std::unique_ptr<const counted>{new counted{value, live}};
+}
+
+} // namespace
+
+TEST(json_frozen_test, freeze)
+{
+    const auto value = json::parse(text.data(), text.size());
+    const auto frozen = json::freeze(value);
+    EXPECT_EQ(value.dump(true), frozen->root().dump(true));
+    EXPECT_EQ(99, frozen->root()["nested"]["problems"].int_value());
+    EXPECT_EQ("a string that is too long to be stored inside the istring",
+              frozen->root()["long"].string_value());
+    EXPECT_EQ(1u, frozen->storage().blocks());
+    EXPECT_EQ(nullptr, json::arena::current());
+}
+
+TEST(json_frozen_test, publish)
+{
+    std::atomic<int> live{0};
+    json::publisher<counted>::snapshot kept;
+    {
+        json::publisher<counted> config{make_counted(1, live)};
+        auto first = config.acquire();
+        EXPECT_EQ(1, first->value);
+
+        // replaced, but kept until the snapshot is done with it
+        config.publish(make_counted(2, live));
+        EXPECT_EQ(2, live);
+        EXPECT_EQ(1, first->value);
+        EXPECT_EQ(2, config.acquire()->value);
+        first.reset();
+        EXPECT_EQ(1, live);
+
+        // a snapshot may outlive the publisher
+        kept = config.acquire();
+        config.publish(nullptr);
+        EXPECT_FALSE(config.acquire());
+    }
+    EXPECT_EQ(1, live);
+    EXPECT_EQ(2, kept->value);
+    kept.reset();
+    EXPECT_EQ(0, live);
+}
+
+TEST(json_frozen_test, many_snapshots)
+{
+    std::atomic<int> live{0};
+    json::publisher<counted> config{make_counted(1, live)};
+
+    // enough for the count in the publisher to be folded into the entry
+    std::vector<json::publisher<counted>::snapshot> snapshots;
+    for (int i = 0; i < 100000; ++i)
+    {
+        snapshots.push_back(config.acquire());
+    }
+    config.publish(make_counted(2, live));
+    EXPECT_EQ(2, live);
+    snapshots.resize(1);
+    EXPECT_EQ(1, snapshots[0]->value);
+    snapshots.clear();
+    EXPECT_EQ(1, live);
+}
+
+TEST(json_frozen_test, concurrent_folds)
+{
+    std::atomic<int> live{0};
+    json::publisher<counted> config{make_counted(1, live)};
+
+    // More threads than cores, so readers that have to fold are often held
+    // up while the rest take more snapshots than the count in the word can
+    // hold. Values are replaced meanwhile, and each must outlive its
+    // snapshots.
+    std::atomic<int> done{0};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 32; ++i)
+    {
+        readers.emplace_back([&]()
+                             {
+                                 std::vector<
+                                     json::publisher<counted>::snapshot>
+                                     snapshots;
+                                 for (int j = 0; j < 8192; ++j)
+                                 {
+                                     snapshots.push_back(config.acquire());
+                                 }
+                                 for (const auto& snapshot : snapshots)
+                                 {
+                                     if (snapshot->value < 1)
+                                     {
+                                         ++failures;
+                                     }
+                                 }
+                                 ++done;
+                             });
+    }
+
+    for (int value = 2; done != 32; ++value)
+    {
+        config.publish(make_counted(value, live));
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, failures);
+    EXPECT_EQ(1, live);
+}
+
+TEST(json_frozen_test, readers)
+{
+    json::publisher<json::frozen> config{
+        json::freeze(json::parse(text.data(), text.size()))};
+
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&]()
+                             {
+                                 while (!done)
+                                 {
+                                     const auto snapshot = config.acquire();
+                                     const auto& root = snapshot->root();
+                                     if (root["nested"]["color"].string_value()
+                                             != "orange")
+                                     {
+                                         ++failures;
+                                     }
+                                 }
+                             });
+    }
+
+    auto value = json::parse(text.data(), text.size());
+    for (int i = 0; i < 200; ++i)
+    {
+        value["nested"]["problems"] = i;
+        config.publish(json::freeze(value));
+    }
+    done = true;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, failures);
+    EXPECT_EQ(199, config.acquire()->root()["nested"]["problems"].int_value());
+}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json/minify.h"
+
+#include <string>
+
+using namespace native;
+
+TEST(json_minify_test, in_place)
+{
+    std::string text = R"json({
+  "array": [
+    2,
+    "c++ and  spaces",
+    7,
+    {
+      "color": "orange",
+      "escaped \" quote ": "\\",
+      "problems": 99
+    }
+  ],
+  "bar": "string",
+  "foo": 42
+}
+)json";
+
+    json::minify(text);
+    EXPECT_EQ(R"json({"array":[2,"c++ and  spaces",7,{"color":"orange",)json"
+              R"json("escaped \" quote ":"\\","problems":99}],"bar":"string",)json"
+              R"json("foo":42})json",
+              text);
+}
+
+TEST(json_minify_test, string_builder)
+{
+    string_builder builder;
+    builder << "prefix ";
+    json::minify(std::string("[ 1, \t\"a b\" ,\r\n null ]"), builder);
+    EXPECT_EQ("prefix [1,\"a b\",null]", builder.str());
+}
+
+TEST(json_minify_test, long_runs)
+{
+    // whitespace and strings both crossing 64 byte blocks
+    std::string text = "[" + std::string(100, ' ') + "\"" +
+                       std::string(100, ' ') + "\\\"" + std::string(50, ' ') +
+                       "\"" + std::string(70, '\n') + "]";
+
+    std::string expected = "[\"" + std::string(100, ' ') + "\\\"" +
+                           std::string(50, ' ') + "\"]";
+
+    std::string result(text.size(), '\0');
+    result.resize(json::minify(text.data(), text.size(), &result[0]));
+    EXPECT_EQ(expected, result);
+
+    json::minify(text);
+    EXPECT_EQ(expected, text);
+
+    std::string empty;
+    json::minify(empty);
+    EXPECT_TRUE(empty.empty());
+}
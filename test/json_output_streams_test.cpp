@@ -0,0 +1,219 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json.h"
+#include "native/json/async_stream.h"
+#include "native/json/output_streams.h"
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace native;
+
+namespace
+{
+
+template <typename Stream>
+void write_document(Stream& ostr)
+{
+    json::writer<Stream> writer{ostr};
+    writer.open_object();
+    writer.append("foo", 42);
+    writer.append("bar", "string");
+    writer.close_object();
+}
+
+} // namespace
+
+TEST(json_output_streams_test, string_stream)
+{
+    std::string str = "prefix ";
+    json::string_stream<> ostr{str};
+    write_document(ostr);
+    EXPECT_EQ(R"json(prefix {"foo":42,"bar":"string"})json", str);
+}
+
+TEST(json_output_streams_test, string_builder)
+{
+    string_builder builder;
+    write_document(builder);
+    EXPECT_EQ(R"json({"foo":42,"bar":"string"})json", builder.str());
+
+    // many small writes grow the capacity geometrically
+    for (int i = 0; i < 1000; ++i)
+    {
+        builder.write("abc", 3);
+    }
+    EXPECT_EQ(3000u, builder.size());
+    EXPECT_LT(builder.capacity(), 6000u);
+}
+
+TEST(json_output_streams_test, buffer_stream)
+{
+    char buffer[64];
+    json::buffer_stream ostr{buffer, sizeof(buffer)};
+    write_document(ostr);
+    EXPECT_FALSE(ostr.overflow());
+    EXPECT_EQ(R"json({"foo":42,"bar":"string"})json",
+              std::string(ostr.data(), ostr.size()));
+
+    json::buffer_stream small{buffer, 10};
+    write_document(small);
+    EXPECT_TRUE(small.overflow());
+    EXPECT_EQ(R"json({"foo":42,)json", std::string(small.data(), small.size()));
+}
+
+#if defined(NATIVE_JSON_FD_STREAM)
+TEST(json_output_streams_test, fd_stream)
+{
+    auto file = std::tmpfile();
+    ASSERT_NE(nullptr, file);
+
+    {
+        // a tiny buffer to exercise flushing and unbuffered writes
+        json::fd_stream ostr{fileno(file), 8};
+        write_document(ostr);
+        ostr.write("0123456789abcdef", 16);
+        ostr.flush();
+    }
+
+    std::rewind(file);
+    char buffer[128] = {};
+    const auto length = std::fread(buffer, 1, sizeof(buffer), file);
+    std::fclose(file);
+
+    EXPECT_EQ(R"json({"foo":42,"bar":"string"}0123456789abcdef)json",
+              std::string(buffer, length));
+}
+#endif
+
+#if defined(NATIVE_JSON_FD_STREAM)
+TEST(json_output_streams_test, iovec_stream)
+{
+    auto file = std::tmpfile();
+    ASSERT_NE(nullptr, file);
+
+    const std::string large(100, 'x');
+    const std::string escaped = large + "\"" + large;
+    {
+        // tiny blocks so that we run out and flush along the way
+        json::iovec_stream ostr{fileno(file), 8, 2, 16};
+        json::writer<json::iovec_stream> writer{ostr};
+        writer.open_array();
+        for (int i = 0; i < 10; ++i)
+        {
+            writer.append(i);
+        }
+        writer.append_reference(large);
+        writer.append_reference(escaped);
+        writer.append("short");
+
+        // copied, so the temporary can go before the flush
+        writer.append(std::string(large.size(), 'y'));
+        writer.close_array();
+        ostr.flush();
+    }
+
+    std::rewind(file);
+    std::string result(1024, '\0');
+    result.resize(std::fread(&result[0], 1, result.size(), file));
+    std::fclose(file);
+
+    EXPECT_EQ("[0,1,2,3,4,5,6,7,8,9,\"" + large + "\",\"" + large + "\\\"" +
+                  large + "\",\"short\",\"" + std::string(large.size(), 'y') +
+                  "\"]",
+              result);
+}
+#endif
+
+namespace
+{
+
+// fails the first write only
+struct failing_sink
+{
+    void write(const char* s, std::size_t length)
+    {
+        if (!failed)
+        {
+            failed = true;
+            throw std::runtime_error("disk full");
+        }
+        written.append(s, length);
+    }
+
+    bool failed = false;
+    std::string written;
+};
+
+} // namespace
+
+TEST(json_output_streams_test, async_stream)
+{
+    std::ostringstream sink;
+    {
+        // a small buffer so that the writer gets ahead of the sink
+        json::async_stream<std::ostringstream> ostr{sink, 4};
+        for (int i = 0; i < 100; ++i)
+        {
+            write_document(ostr);
+        }
+        ostr.flush();
+        EXPECT_EQ(100 * std::string(R"json({"foo":42,"bar":"string"})json")
+                            .size(),
+                  sink.str().size());
+
+        write_document(ostr);
+        ostr.close();
+        ostr.close();
+    }
+
+    std::string expected;
+    for (int i = 0; i < 101; ++i)
+    {
+        expected += R"json({"foo":42,"bar":"string"})json";
+    }
+    EXPECT_EQ(expected, sink.str());
+}
+
+TEST(json_output_streams_test, async_stream_error)
+{
+    failing_sink sink;
+    json::async_stream<failing_sink> ostr{sink, 16};
+    write_document(ostr);
+    EXPECT_THROW(ostr.flush(), std::runtime_error);
+
+    // the rest still gets written
+    EXPECT_NO_THROW(ostr.close());
+    EXPECT_EQ(R"json("string"})json", sink.written);
+}
+
+TEST(json_output_streams_test, dump_std_string)
+{
+    json::any value{{{"foo", 42}, {"bar", "string"}}};
+    std::string str = "replaced";
+    value.dump(str, true);
+    EXPECT_EQ(R"json({"bar":"string","foo":42})json", str);
+
+    // left alone when writing fails part way
+    value["invalid"] = istring("\xff\xfe");
+    EXPECT_THROW(value.dump(str, true), std::runtime_error);
+    EXPECT_EQ(R"json({"bar":"string","foo":42})json", str);
+}
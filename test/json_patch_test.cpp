@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json.h"
+#include "native/json/patch.h"
+
+#include <random>
+#include <string>
+
+using namespace native;
+
+namespace
+{
+
+json::any parse(const std::string& text)
+{
+    return json::parse(text.data(), text.size());
+}
+
+// Applies the patch to a copy of from, so from is left alone.
+json::any patched(const json::any& from, const json::any& operations)
+{
+    auto result = from.share();
+    json::patch(result, operations);
+    return result;
+}
+
+} // namespace
+
+TEST(json_patch_test, resolve)
+{
+    // from RFC 6901
+    const auto value = parse(R"({"foo":["bar","baz"],"":0,"a/b":1,"c%d":2,)"
+                             R"("e^f":3,"g|h":4,"i\\j":5,"k\"l":6," ":7,)"
+                             R"("m~n":8})");
+    EXPECT_EQ(value, *json::resolve(value, ""));
+    EXPECT_EQ(parse(R"(["bar","baz"])"), *json::resolve(value, "/foo"));
+    EXPECT_EQ("bar", json::resolve(value, "/foo/0")->string_value());
+    EXPECT_EQ(0, json::resolve(value, "/")->int_value());
+    EXPECT_EQ(1, json::resolve(value, "/a~1b")->int_value());
+    EXPECT_EQ(5, json::resolve(value, "/i\\j")->int_value());
+    EXPECT_EQ(7, json::resolve(value, "/ ")->int_value());
+    EXPECT_EQ(8, json::resolve(value, "/m~0n")->int_value());
+
+    EXPECT_EQ(nullptr, json::resolve(value, "/missing"));
+    EXPECT_EQ(nullptr, json::resolve(value, "/foo/2"));
+    EXPECT_EQ(nullptr, json::resolve(value, "/foo/-"));
+    EXPECT_EQ(nullptr, json::resolve(value, "/foo/01"));
+    EXPECT_EQ(nullptr, json::resolve(value, "/foo/0/bar"));
+    EXPECT_THROW(json::resolve(value, "foo"), json::patch_error);
+    EXPECT_THROW(json::resolve(value, "/m~2n"), json::patch_error);
+}
+
+TEST(json_patch_test, patch)
+{
+    // from RFC 6902
+    const auto doc = parse(R"({"foo":"bar","baz":[1,2],"qux":{"x":1}})");
+    EXPECT_EQ(parse(R"({"foo":"bar","baz":[1,"a",2],"qux":{"x":1}})"),
+              patched(doc, parse(R"([{"op":"add","path":"/baz/1",)"
+                                 R"("value":"a"}])")));
+    EXPECT_EQ(parse(R"({"foo":"bar","baz":[1,2,3],"qux":{"x":1}})"),
+              patched(doc, parse(R"([{"op":"add","path":"/baz/-",)"
+                                 R"("value":3}])")));
+    EXPECT_EQ(parse(R"({"foo":"bar","baz":[2],"qux":{"x":1}})"),
+              patched(doc, parse(R"([{"op":"remove","path":"/baz/0"}])")));
+    EXPECT_EQ(parse(R"({"foo":"boo","baz":[1,2],"qux":{"x":1}})"),
+              patched(doc, parse(R"([{"op":"replace","path":"/foo",)"
+                                 R"("value":"boo"}])")));
+    EXPECT_EQ(parse(R"({"foo":"bar","baz":[1,2],"qux":{"x":1,"y":"bar"}})"),
+              patched(doc, parse(R"([{"op":"copy","from":"/foo",)"
+                                 R"("path":"/qux/y"}])")));
+    EXPECT_EQ(parse(R"({"baz":[1,2],"qux":{"x":1,"y":"bar"}})"),
+              patched(doc, parse(R"([{"op":"move","from":"/foo",)"
+                                 R"("path":"/qux/y"}])")));
+    EXPECT_EQ(parse(R"({"foo":"bar","baz":[2,1],"qux":{"x":1}})"),
+              patched(doc, parse(R"([{"op":"move","from":"/baz/0",)"
+                                 R"("path":"/baz/1"}])")));
+    EXPECT_EQ(parse("[1]"),
+              patched(doc, parse(R"([{"op":"add","path":"","value":[1]}])")));
+    EXPECT_EQ(doc, patched(doc, parse(R"([{"op":"test","path":"/baz",)"
+                                      R"("value":[1,2]}])")));
+
+    // the document is left as it was when an operation fails
+    auto value = doc.share();
+    EXPECT_THROW(json::patch(value, parse(R"([{"op":"remove","path":"/foo"},)"
+                                          R"({"op":"test","path":"/baz/0",)"
+                                          R"("value":2}])")),
+                 json::patch_error);
+    EXPECT_EQ(doc, value);
+
+    const auto fails = [&](const std::string& operations)
+    {
+        auto copy = doc.share();
+        EXPECT_THROW(json::patch(copy, parse(operations)), json::patch_error)
+            << operations;
+    };
+    fails(R"({"op":"remove","path":"/foo"})");
+    fails(R"([{"op":"remove","path":"/missing"}])");
+    fails(R"([{"op":"remove","path":"/baz/2"}])");
+    fails(R"([{"op":"add","path":"/baz/3","value":0}])");
+    fails(R"([{"op":"add","path":"/missing/x","value":0}])");
+    fails(R"([{"op":"add","path":"/foo/x","value":0}])");
+    fails(R"([{"op":"add","path":"/baz/1"}])");
+    fails(R"([{"op":"replace","path":"/missing","value":0}])");
+    fails(R"([{"op":"move","from":"/qux","path":"/qux/y"}])");
+    fails(R"([{"op":"copy","from":"/missing","path":"/y"}])");
+    fails(R"([{"op":"test","path":"/missing","value":null}])");
+    fails(R"([{"op":"frobnicate","path":"/foo"}])");
+    fails(R"([{"op":1,"path":"/foo"}])");
+}
+
+TEST(json_patch_test, diff)
+{
+    const auto from = parse(R"({"a":1,"b":{"c":[1,2,3],"d":"x"},"e/f":null})");
+    const auto same = parse(R"({"e/f":null,"b":{"d":"x","c":[1,2,3]},"a":1})");
+    EXPECT_EQ(parse("[]"), json::diff(from, same));
+
+    const auto to = parse(R"({"a":2,"b":{"c":[0,1,3,4],"d":"x"},"g":true})");
+    const auto operations = json::diff(from, to);
+    EXPECT_EQ(to, patched(from, operations));
+    EXPECT_EQ(6u, operations.size()) << operations.dump();
+
+    // unrelated values are replaced
+    EXPECT_EQ(parse(R"([{"op":"replace","path":"","value":[1]}])"),
+              json::diff(from, parse("[1]")));
+
+    // lazy integers too large for 64 bits are compared as reals
+    json::any big;
+    json::any::handler handler{big, json::number_lazy};
+    json::parser{}.parse(std::string{"[123456789012345678901234567890]"},
+                         handler);
+    EXPECT_EQ(parse("[]"), json::diff(big, parse("[1.2345678901234568e29]")));
+    EXPECT_EQ(1u, json::diff(big, parse("[1]")).size());
+
+    // changed through a reference taken before it was hashed
+    auto stale = parse(R"({"k":{"y":1},"z":[1]})");
+    auto& k = stale["k"];
+    stale.hash();
+    k["y"] = 2;
+    EXPECT_EQ(parse("[]"),
+              json::diff(stale, parse(R"({"k":{"y":2},"z":[1]})")));
+    EXPECT_EQ(parse(R"([{"op":"replace","path":"/k/y","value":3}])"),
+              json::diff(stale, parse(R"({"k":{"y":3},"z":[1]})")));
+}
+
+TEST(json_patch_test, diff_keyed_arrays)
+{
+    const auto from = parse(R"([{"id":1,"name":"a","tags":["x"]},)"
+                            R"({"id":2,"name":"a"},{"id":3,"name":"c"}])");
+    const auto to = parse(R"([{"id":4,"name":"d"},{"id":1,"name":"a",)"
+                          R"("tags":["x","y"]},{"id":3,"name":"e"}])");
+    const auto operations = json::diff(from, to);
+    EXPECT_EQ(to, patched(from, operations));
+
+    // elements are matched by id, so only what changed in them is written
+    EXPECT_EQ(parse(R"([{"op":"add","path":"/0",)"
+                    R"("value":{"id":4,"name":"d"}},)"
+                    R"({"op":"add","path":"/1/tags/1","value":"y"},)"
+                    R"({"op":"remove","path":"/2"},)"
+                    R"({"op":"replace","path":"/2/name","value":"e"}])"),
+              operations);
+}
+
+TEST(json_patch_test, round_trip)
+{
+    std::mt19937 random{42};
+    const auto pick = [&](std::size_t n)
+    {
+        return static_cast<std::size_t>(random() % n);
+    };
+
+    // random edits to random documents
+    for (int round = 0; round < 200; ++round)
+    {
+        json::any from{json::json_array};
+        for (std::size_t i = 0, n = pick(8); i < n; ++i)
+        {
+            json::any element{json::json_object};
+            element["id"] = static_cast<int>(i);
+            element["value"] = static_cast<int>(pick(3));
+            element["list"] = parse("[1,2,3]");
+            from.push_back(element);
+        }
+
+        auto to = from.share();
+        for (std::size_t edit = 0, n = pick(6); edit < n; ++edit)
+        {
+            const auto size = to.size();
+            switch (pick(5))
+            {
+                case 0:
+                    to.emplace(to.begin() + pick(size + 1),
+                               parse(R"({"id":)" + std::to_string(100 + edit) +
+                                     R"(,"value":0,"list":[]})"));
+                    break;
+                case 1:
+                    if (size)
+                    {
+                        to.erase(to.begin() + pick(size));
+                    }
+                    break;
+                case 2:
+                    if (size)
+                    {
+                        to[pick(size)]["value"] = static_cast<int>(pick(3));
+                    }
+                    break;
+                case 3:
+                    if (size)
+                    {
+                        to[pick(size)]["list"].push_back(4);
+                    }
+                    break;
+                case 4:
+                    if (size > 1)
+                    {
+                        const auto moved = to[pick(size)].share();
+                        to.erase(to.begin() + pick(size));
+                        to.push_back(moved);
+                    }
+                    break;
+            }
+        }
+
+        const auto operations = json::diff(from, to);
+        EXPECT_EQ(to, patched(from, operations)) << operations.dump();
+    }
+}
@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json/validate.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+using namespace native;
+
+TEST(json_validate_test, well_formed)
+{
+    EXPECT_TRUE(json::validate(std::string("{}")));
+    EXPECT_TRUE(json::validate(std::string("[]")));
+    EXPECT_TRUE(json::validate(std::string(" [ 1 , -2.5e+3, 0, true, false,"
+                                           " null, \"\", {} ] ")));
+    EXPECT_TRUE(json::validate(std::string(R"json({
+  "array": [2, "c++", 1.5, {"color": "orange", "problems": 99}],
+  "escapes": "\"\\\/\b\f\n\r\t\u00e9\ud834\udd1e",
+  "braces in strings": "{[:,]}",
+  "nested": {"a": {"b": {"c": []}}}
+})json")));
+}
+
+TEST(json_validate_test, malformed)
+{
+    const char* malformed[] = {
+        "",           "42",          "\"foo\"",        "[",
+        "]",          "{",           "[1,]",           "[,1]",
+        "[1 2]",      "{\"a\"}",     "{\"a\":}",       "{\"a\" 1}",
+        "{\"a\":1,}", "{1:2}",       "[1}",            "{\"a\":1]",
+        "[] []",      "[tru]",       "[truex]",        "[nul]",
+        "[01]",       "[1.]",        "[.5]",           "[1e]",
+        "[-]",        "[+1]",        "[\"abc]",        "[\"a\"b]",
+        "[\"\\x\"]",  "[\"\\u12\"]", "[\"\\ud834\"]",  "[\"\t\"]",
+        "[\x01]",     "[\"a\" \"b\"]", "[\\\"a\"]",
+    };
+
+    for (const auto* source : malformed)
+    {
+        EXPECT_FALSE(json::validate(source, std::strlen(source))) << source;
+    }
+}
+
+TEST(json_validate_test, truncated_escapes)
+{
+    // nothing past the input is read, including at the end of a block
+    const std::string sources[] = {
+        "[\"\\", "[\"\\u12", "[\"" + std::string(61, ' ') + "\\",
+        "[\"" + std::string(62, ' ') + "\\",
+    };
+    for (const auto& source : sources)
+    {
+        std::unique_ptr<char[]> copy{new char[source.size()]};
+        std::memcpy(copy.get(), source.data(), source.size());
+        EXPECT_FALSE(json::validate(copy.get(), source.size())) << source;
+    }
+}
+
+TEST(json_validate_test, long_strings_cross_blocks)
+{
+    // an odd run of backslashes escapes the closing quote
+    const std::string prefix = "[\"" + std::string(100, ' ');
+    const std::string suffix = "\", " + std::string(70, '1') + "]";
+    EXPECT_FALSE(json::validate(prefix + std::string(127, '\\') + suffix));
+    EXPECT_TRUE(json::validate(prefix + std::string(128, '\\') + suffix));
+}
+
+TEST(json_validate_test, utf8)
+{
+    const std::string valid = "[\"\xce\xba\xe2\x82\xac\xf0\x9d\x84\x9e\"]";
+    EXPECT_TRUE(json::validate(valid, true));
+
+    const char* invalid[] = {
+        "[\"\xc0\xaf\"]",         // overlong
+        "[\"\xed\xa0\x80\"]",     // surrogate
+        "[\"\xf4\x90\x80\x80\"]", // above U+10FFFF
+        "[\"\xe2\x82\"]",         // truncated
+        "[\"\x80\"]",             // lone continuation
+    };
+    for (const auto* source : invalid)
+    {
+        EXPECT_TRUE(json::validate(source, std::strlen(source)));
+        EXPECT_FALSE(json::validate(source, std::strlen(source), true));
+    }
+}
+
+TEST(json_validate_test, max_depth)
+{
+    const std::string source = "[[[{\"a\":[]}]]]";
+    EXPECT_TRUE(json::validate(source));
+    EXPECT_TRUE(json::validate(source, false, 5));
+    EXPECT_FALSE(json::validate(source, false, 4));
+
+    const std::string deep = std::string(1000, '[') + std::string(1000, ']');
+    EXPECT_TRUE(json::validate(deep));
+    EXPECT_FALSE(json::validate(deep, false, 999));
+    EXPECT_FALSE(json::validate(deep.substr(1)));
+
+    // siblings that each go past the levels kept inline
+    const std::string sibling =
+        std::string(70, '[') + R"({"a":[1]})" + std::string(70, ']');
+    std::string siblings = "[" + sibling;
+    for (int i = 0; i < 100; ++i)
+    {
+        siblings += "," + sibling;
+    }
+    EXPECT_TRUE(json::validate(siblings + "]"));
+    EXPECT_FALSE(json::validate(siblings + "}"));
+}
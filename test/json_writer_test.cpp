@@ -18,6 +18,8 @@
 
 #include "native/json/writer.h"
 
+#include <cstdlib>
+#include <limits>
 #include <sstream>
 
 using namespace native;
@@ -119,3 +121,203 @@ TEST(json_writer_test, write_utf_8)
               ostr.str());
     }
 }
+
+TEST(json_writer_test, write_numbers)
+{
+    std::ostringstream ostr;
+    json::writer<std::ostringstream> writer(ostr);
+    writer.open_object();
+    writer.append("zero", 0);
+    writer.append("int", -1234567);
+    writer.append("min", std::numeric_limits<long long>::min());
+    writer.append("max", std::numeric_limits<unsigned long long>::max());
+    writer.append("short", static_cast<short>(-7));
+    writer.append("double", 0.1);
+    writer.append("whole", 42.0);
+    writer.append("float", 1.1f);
+    writer.append("long double", 2.5L);
+    writer.append("small", 1e-7);
+    writer.append("large", 1e21);
+    writer.append("nan", std::numeric_limits<double>::quiet_NaN());
+    writer.append("inf", -std::numeric_limits<double>::infinity());
+    writer.close_object();
+
+    EXPECT_EQ(R"json({"zero":0,"int":-1234567,"min":-9223372036854775808,)json"
+              R"json("max":18446744073709551615,"short":-7,"double":0.1,)json"
+              R"json("whole":42,"float":1.1,"long double":2.5,"small":1e-7,)json"
+              R"json("large":1e21,"nan":null,"inf":null})json",
+              ostr.str());
+}
+
+TEST(json_writer_test, round_trip_doubles)
+{
+    const double values[] = {
+        3.141592653589793,       1.0 / 3.0,
+        5e-324,                  1.7976931348623157e308,
+        -2.2250738585072014e-308, 123456789012345680.0,
+    };
+
+    for (auto value : values)
+    {
+        std::ostringstream ostr;
+        json::writer<std::ostringstream> writer(ostr);
+        writer.append(value);
+        EXPECT_EQ(value, std::strtod(ostr.str().c_str(), nullptr))
+            << ostr.str();
+    }
+}
+
+TEST(json_writer_test, write_escapes)
+{
+    const char text[] = "quote \" backslash \\ slash / tab \t newline \n "
+                        "bell \x07 unit \x1f nul \0 end";
+    std::ostringstream ostr;
+    json::writer<std::ostringstream> writer(ostr);
+    writer.append(std::string(text, sizeof(text) - 1));
+
+    EXPECT_EQ(R"json("quote \" backslash \\ slash / tab \t newline \n )json"
+              R"json(bell \u0007 unit \u001f nul \u0000 end")json",
+              ostr.str());
+}
+
+TEST(json_writer_test, write_long_strings)
+{
+    // runs longer than a vector with escapes at either end
+    const std::string plain(100, 'x');
+    std::ostringstream ostr;
+    json::writer<std::ostringstream> writer(ostr);
+    writer.append("\"" + plain + "\xC2\xA2" + plain + "\n");
+
+    EXPECT_EQ("\"\\\"" + plain + "\\u00a2" + plain + "\\n\"", ostr.str());
+}
+
+TEST(json_writer_test, write_raw_utf_8)
+{
+    const std::string text = "κόσμε \"\xF0\x9D\x84\x9E\"\n";
+    const std::string expected = "\"κόσμε \\\"\xF0\x9D\x84\x9E\\\"\\n\"";
+
+    {
+        std::ostringstream ostr;
+        json::writer<std::ostringstream> writer(ostr, 0, json::utf8_raw);
+        writer.append(text);
+        EXPECT_EQ(expected, ostr.str());
+    }
+
+    {
+        std::ostringstream ostr;
+        json::writer<std::ostringstream> writer(ostr, 0, json::utf8_validate);
+        writer.append(text);
+        EXPECT_EQ(expected, ostr.str());
+    }
+
+    {
+        // invalid sequences are copied as is
+        std::ostringstream ostr;
+        json::writer<std::ostringstream> writer(ostr, 0, json::utf8_raw);
+        writer.append("\xC0\xAF");
+        EXPECT_EQ("\"\xC0\xAF\"", ostr.str());
+    }
+}
+
+TEST(json_writer_test, write_validated_utf_8)
+{
+    const char* invalid[] = {
+        "\xC0\xAF",         // overlong
+        "\xED\xA0\x80",     // surrogate
+        "\xF4\x90\x80\x80", // above U+10FFFF
+        "abc\xE2\x82",      // truncated
+        "\x80",             // lone continuation
+    };
+
+    for (const auto* text : invalid)
+    {
+        std::ostringstream ostr;
+        json::writer<std::ostringstream> writer(ostr, 0, json::utf8_validate);
+        EXPECT_THROW(writer.append(text), std::runtime_error) << text;
+    }
+}
+
+TEST(json_writer_test, write_static_keys)
+{
+    static constexpr auto foo = NATIVE_JSON_KEY("foo");
+    static_assert(foo.size() == 6, "");
+
+    std::ostringstream ostr;
+    json::writer<std::ostringstream> writer(ostr, 2);
+    writer.open_object();
+    writer.append(foo, 42);
+    writer.key(NATIVE_JSON_KEY("array"));
+    writer.open_array();
+    writer.close_array();
+    writer.close_object();
+
+    EXPECT_EQ(R"json({
+  "foo": 42,
+  "array": []
+})json",
+              ostr.str());
+
+    static_assert(json::detail::is_plain_key("plain key", 9), "");
+    static_assert(!json::detail::is_plain_key("quote\"", 6), "");
+    static_assert(!json::detail::is_plain_key("tab\t", 4), "");
+}
+
+TEST(json_writer_test, write_nested)
+{
+    std::ostringstream ostr;
+    json::writer<std::ostringstream> writer(ostr, 2);
+    writer.open_array();
+    writer.open_array();
+    writer.append(1);
+    writer.close_array();
+    writer.open_array();
+    writer.close_array();
+    writer.open_object();
+    writer.key("object");
+    writer.open_object();
+    writer.close_object();
+    writer.close_object();
+    writer.open_object();
+    writer.close_object();
+    writer.close_array();
+
+    EXPECT_EQ(R"json([
+  [
+    1
+  ],
+  [],
+  {
+    "object": {}
+  },
+  {}
+])json",
+              ostr.str());
+}
+
+TEST(json_writer_test, write_deep)
+{
+    // deeper than the inline state stack
+    std::ostringstream ostr;
+    json::writer<std::ostringstream, 4> writer(ostr, 1);
+    for (int i = 0; i < 10; ++i)
+    {
+        writer.open_array();
+    }
+    writer.append(true);
+    for (int i = 0; i < 10; ++i)
+    {
+        writer.close_array();
+    }
+
+    std::string expected;
+    for (int i = 0; i < 10; ++i)
+    {
+        expected += "[\n" + std::string(i + 1, ' ');
+    }
+    expected += "true";
+    for (int i = 9; i >= 0; --i)
+    {
+        expected += "\n" + std::string(i, ' ') + "]";
+    }
+    EXPECT_EQ(expected, ostr.str());
+}
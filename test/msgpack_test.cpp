@@ -0,0 +1,256 @@
+//
+// Copyright (c) 2015 Mike Naquin. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "test.h"
+
+#include "native/json.h"
+#include "native/json/output_streams.h"
+#include "native/msgpack/parser.h"
+#include "native/msgpack/writer.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+using namespace native;
+
+namespace
+{
+
+// Records the callbacks, with the type of each number.
+struct trace_handler
+{
+    using char_type = char;
+
+    json::data_type start_array()
+    {
+        trace += "[ ";
+        return array_type;
+    }
+    void end_array() { trace += "] "; }
+
+    void start_object() { trace += "{ "; }
+    void end_object() { trace += "} "; }
+
+    json::data_type key(const char_type* key, std::size_t length)
+    {
+        trace += std::string(key, length) + ": ";
+        return std::string(key, length) == "age" ? json::type_unsigned_short
+                                                 : json::type_unknown;
+    }
+
+    void value(const char_type* val, std::size_t length)
+    {
+        EXPECT_EQ('\0', val[length]);
+        trace += "\"" + std::string(val, length) + "\" ";
+    }
+    void value(std::nullptr_t) { trace += "null "; }
+    void value(bool val) { trace += val ? "true " : "false "; }
+    void value(unsigned short val) { number("u16", val); }
+    void value(std::int32_t val) { number("i32", val); }
+    void value(std::uint32_t val) { number("u32", val); }
+    void value(std::int64_t val) { number("i64", val); }
+    void value(std::uint64_t val) { number("u64", val); }
+    void value(long long val) { number("ll", val); }
+    void value(unsigned long long val) { number("ull", val); }
+    void value(float val) { number("f", val); }
+    void value(double val) { number("d", val); }
+    void value(long double val) { number("ld", val); }
+
+    template <typename T>
+    void number(const char* type, T val)
+    {
+        trace += std::string(type) + ":" + std::to_string(val) + " ";
+    }
+
+    json::data_type array_type = json::type_unknown;
+    std::string trace;
+};
+
+std::string trace(const std::string& input,
+                  json::data_type array_type = json::type_unknown)
+{
+    trace_handler handler;
+    handler.array_type = array_type;
+    msgpack::parser{}.parse(input, handler);
+    return handler.trace;
+}
+
+// a string literal that may have null characters
+template <std::size_t Size>
+std::string bytes(const char (&data)[Size])
+{
+    return std::string(data, Size - 1);
+}
+
+} // namespace
+
+TEST(msgpack_test, write)
+{
+    // the example from msgpack.org
+    const auto expected = bytes("\x82\xa7"
+                                "compact\xc3\xa6"
+                                "schema\x00");
+
+    std::string unsized;
+    json::string_stream<> ostr{unsized};
+    msgpack::writer<json::string_stream<>> writer{ostr};
+    writer.open_object();
+    writer.append("compact", true);
+    writer.append(NATIVE_JSON_KEY("schema"), 0);
+    writer.close_object();
+    EXPECT_EQ(expected, unsized);
+
+    std::string sized;
+    json::string_stream<> sized_ostr{sized};
+    msgpack::writer<json::string_stream<>> sized_writer{sized_ostr};
+    sized_writer.open_object(2);
+    sized_writer.append("compact", true);
+    sized_writer.append("schema", 0);
+    sized_writer.close_object();
+    EXPECT_EQ(expected, sized);
+}
+
+TEST(msgpack_test, write_sizes)
+{
+    std::string output;
+    json::string_stream<> ostr{output};
+    msgpack::writer<json::string_stream<>> writer{ostr};
+    writer.open_array();
+    writer.open_array();
+    for (int i = 0; i < 16; ++i)
+    {
+        writer.append(nullptr);
+    }
+    writer.close_array();
+    writer.append(std::string(32, 'x'));
+    writer.append(std::string(256, 'y'));
+    writer.open_object(1);
+    writer.open_array();
+    writer.close_array();
+    writer.append(nullptr);
+    writer.close_object();
+    writer.close_array();
+
+    const auto expected = bytes("\x94\xdc\x00\x10") + std::string(16, '\xc0') +
+                          "\xd9\x20" + std::string(32, 'x') +
+                          bytes("\xda\x01\x00") + std::string(256, 'y') +
+                          "\x81\x90\xc0";
+    EXPECT_EQ(expected, output);
+}
+
+TEST(msgpack_test, numbers)
+{
+    std::string output;
+    json::string_stream<> ostr{output};
+    msgpack::writer<json::string_stream<>> writer{ostr};
+    writer.open_array(14);
+    writer.append(127);
+    writer.append(128);
+    writer.append(65535);
+    writer.append(65536);
+    writer.append(4294967296ULL);
+    writer.append(std::numeric_limits<unsigned long long>::max());
+    writer.append(-32);
+    writer.append(-33);
+    writer.append(-32769);
+    writer.append(std::numeric_limits<int>::min());
+    writer.append(std::numeric_limits<long long>::min());
+    writer.append(1.5f);
+    writer.append(0.25);
+    writer.append(false);
+    writer.close_array();
+
+    EXPECT_EQ(bytes("\x9e\x7f\xcc\x80\xcd\xff\xff\xce\x00\x01\x00\x00"
+                    "\xcf\x00\x00\x00\x01\x00\x00\x00\x00"
+                    "\xcf\xff\xff\xff\xff\xff\xff\xff\xff"
+                    "\xe0\xd0\xdf\xd2\xff\xff\x7f\xff"
+                    "\xd2\x80\x00\x00\x00"
+                    "\xd3\x80\x00\x00\x00\x00\x00\x00\x00"
+                    "\xca\x3f\xc0\x00\x00"
+                    "\xcb\x3f\xd0\x00\x00\x00\x00\x00\x00\xc2"),
+              output);
+
+    EXPECT_EQ("[ u32:127 u32:128 u32:65535 u32:65536 u64:4294967296 "
+              "u64:18446744073709551615 i32:-32 i32:-33 i32:-32769 "
+              "i32:-2147483648 i64:-9223372036854775808 d:1.500000 "
+              "d:0.250000 false ] ",
+              trace(output));
+
+    // typed like the JSON parser when the handler expects a type
+    EXPECT_EQ("[ f:127.000000 f:128.000000 ",
+              trace(output, json::type_float).substr(0, 28));
+}
+
+TEST(msgpack_test, expected_types)
+{
+    EXPECT_EQ("{ age: u16:70 name: \"jack\" } ",
+              trace("\x82\xa3"
+                    "age\x46\xa4"
+                    "name\xa4"
+                    "jack"));
+    EXPECT_THROW(trace(bytes("\x81\xa3"
+                             "age\xce\x00\x01\x11\x70")),
+                 msgpack::number_too_big_for_expected_type);
+    EXPECT_THROW(trace("\x81\xa3"
+                       "age\xff"),
+                 msgpack::unexpected_signed_value);
+    EXPECT_THROW(trace(bytes("\x81\xa3"
+                             "age\xcb\x3f\xd0\x00\x00\x00\x00\x00\x00")),
+                 msgpack::unexpected_decimal_value);
+}
+
+TEST(msgpack_test, errors)
+{
+    EXPECT_THROW(trace("\x92\x01"), msgpack::unexpected_end_of_input);
+    EXPECT_THROW(trace("\xa5x"), msgpack::unexpected_end_of_input);
+    EXPECT_THROW(trace("\x91\xc1"), msgpack::invalid_type);
+    EXPECT_THROW(trace("\xd4\x01\x01"), msgpack::unsupported_extension);
+    EXPECT_THROW(trace("\x81\x01\x01"), msgpack::expected_string_key);
+    EXPECT_THROW(trace("\x90\x90"), msgpack::expected_end_of_input);
+    EXPECT_THROW(trace(std::string(2000, '\x91') + "\xc0"),
+                 msgpack::nesting_too_deep);
+
+    // a huge size doesn't reserve anything
+    EXPECT_THROW(trace("\xdd\xff\xff\xff\xff\xc0"),
+                 msgpack::unexpected_end_of_input);
+
+    trace_handler handler;
+    const std::string two = "\x91\x01\xa1x";
+    EXPECT_EQ(2u, msgpack::parser{}.parse_prefix(two.data(), two.size(),
+                                                 handler));
+    EXPECT_EQ("[ u32:1 ] ", handler.trace);
+}
+
+TEST(msgpack_test, any_round_trip)
+{
+    const std::string text = R"json({
+  "array": [2, "c++", -7, 1.5, null, true, [], {}],
+  "nested": {"color": "orange", "problems": 99, "big": 10000000000},
+  "unicode": "ö€"
+})json";
+    const auto value = json::parse(text.data(), text.size());
+
+    std::string bytes;
+    json::string_stream<> ostr{bytes};
+    msgpack::writer<json::string_stream<>> writer{ostr};
+    value.dump(writer, true);
+
+    json::any result;
+    json::any::handler handler{result};
+    msgpack::parser{}.parse(bytes, handler);
+    EXPECT_EQ(value.dump(true), result.dump(true));
+}
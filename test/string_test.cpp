@@ -66,6 +66,10 @@ TEST(string, literal)
     EXPECT_EQ("literal", literalCopy);
     EXPECT_EQ(literal, literalCopy);
     EXPECT_EQ(literalCopy, literal);
+
+    // hashed like any other string, without the null character
+    EXPECT_EQ(istring("literal").hash(), literal.hash());
+    EXPECT_EQ("literal"_hash, literal.hash());
 }
 
 TEST(string, attributes)